@@ -0,0 +1,245 @@
+/**
+ * Headless benchmark of the examples' hot kernels and Argon's draw and upload calls, results are written as JSON to track regressions
+ * To compile run `g++ -std=c++17 -O3 -o argon_bench argon_bench.cpp -lSDL2 -pthread` (or build the argon_bench target with CMake)
+ * Usage: ./argon_bench [results.json] [iterations per kernel]
+ * Every app runs offscreen on SDL's software renderer, so draw and upload times are only comparable between runs on the same machine
+*/
+
+#include "../src/Argon.h"
+#include <chrono>
+#include <bitset>
+#include <array>
+#include <vector>
+#include <random>
+#include <initializer_list>
+#include <string>
+#include <ctime>
+
+// Every example gets its own namespace so their helpers don't collide, their main() is never called
+namespace conways {
+	#include "../examples/conways.cpp"
+}
+#undef MAP
+namespace sandpiles {
+	#include "../examples/sandpiles.cpp"
+}
+namespace dla {
+	#include "../examples/dla.cpp"
+}
+#undef MAP
+namespace fractal {
+	#include "../examples/fractal.cpp"
+}
+#undef MAP
+
+struct Result {
+	std::string name;
+	uint32_t iterations;
+	double minMs;
+	double medianMs;
+	double meanMs;
+	double maxMs;
+};
+static std::vector<Result> results;
+static uint32_t iterations = 50;
+
+// Times fn after one warmup call, setup runs untimed before every call
+template<typename Fn, typename Setup>
+void measure(const std::string& name, uint32_t count, Fn fn, Setup setup) {
+	std::vector<double> samples;
+	setup();
+	fn();
+	for(uint32_t i = 0; i < count; ++i) {
+		setup();
+		uint64_t start = SDL_GetPerformanceCounter();
+		fn();
+		samples.push_back((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+	}
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for(double ms : samples) {sum += ms;}
+	results.push_back({name, count, samples.front(), samples[count / 2], sum / count, samples.back()});
+	fprintf(stderr, "%-36s %8u %12.4f %12.4f\n", name.c_str(), count, samples[count / 2], samples.front());
+}
+template<typename Fn>
+void measure(const std::string& name, uint32_t count, Fn fn) {measure(name, count, fn, [] {});}
+
+// Submits the frame's queued draw calls, so drawing is measured together with what SDL does with it
+static void submit(Argon& app) {
+	bool deferred = app.isDeferred();
+	app.setDeferred(false);
+	app.setDeferred(deferred);
+}
+
+struct ConwaysBench : public conways::Conways {
+	void onLoad(WindowEvent event) {
+		Conways::onLoad(event);
+		std::mt19937 rng(1);
+		for(size_t i = 0; i < data.size(); ++i) {data[i] = rng() % 3 == 0;}
+		playing = true;
+	}
+	void gameLoop(double dt) {
+		measure("conways.applyRules", iterations * 20, [&] {applyRules();});
+		measure("conways.render", iterations, [&] {render(0);}, [&] {applyRules(); submit(*this);});
+		stop();
+	}
+	void simulate(double step) {}
+};
+
+struct SandPilesBench : public sandpiles::SandPiles {
+	void onLoad(WindowEvent event) {
+		SandPiles::onLoad(event);
+		sand[(h/2) * w + (w/2)] = h*w*10; // Same as the 4 key, keeps toppling for the whole run
+	}
+	void gameLoop(double dt) {
+		measure("sandpiles.topple", iterations * 4, [&] {topple();});
+		measure("sandpiles.updateTexture", iterations, [&] {updateTexture();}, [&] {topple();});
+		stop();
+	}
+};
+
+struct DLABench : public dla::DLA {
+	void gameLoop(double dt) {
+		measure("dla.step", iterations * 20, [&] {step();}, [&] {
+			while(frozen.size() < MAX_FROZEN && walking.size() < MAX_WALKERS) {spawnWalker();}
+		});
+		// Cleared like every frame so the cluster layer is composited by each call
+		measure("dla.drawFrame", iterations, [&] {drawFrame();}, [&] {submit(*this); clear();});
+		if(cluster != NULL) {
+			// The whole cluster is drawn again, like on the first frame or after the renderer lost the layer
+			measure("dla.drawFrame/redraw", iterations, [&] {drawFrame();}, [&] {submit(*this); clear(); markLayerDirty(cluster);});
+		}
+		stop();
+	}
+};
+
+struct FractalBench : public fractal::FractalVisualizer {
+	void onLoad(WindowEvent event) {} // No async framebuffer, fillPixels() is called directly
+	void gameLoop(double dt) {
+		// Zooming into seahorse valley, deeper zooms have more points that never escape
+		const fractal::F cx = -0.743643887, cy = 0.131825904;
+		std::vector<uint8_t> pixels((size_t)ww() * wh() * 4);
+		Framebuffer fb = {pixels.data(), ww(), wh(), ww() * 4, {0, 0, 0, 0}};
+		for(fractal::F zoom : {1e0L, 1e-2L, 1e-4L, 1e-6L}) {
+			scale = zoom;
+			tx = cx - (params[0] + params[1]) / 2 * zoom;
+			ty = cy - (params[2] + params[3]) / 2 * zoom;
+			char name[64];
+			snprintf(name, sizeof(name), "fractal.fillPixels/zoom_%.0e", (double)zoom);
+			preparePixels();
+			measure(name, iterations / 5 + 1, [&] {fillPixels(fb);});
+		}
+		stop();
+	}
+};
+
+struct DrawBench : public Argon {
+	static constexpr uint32_t count = 10000;
+	Texture* target;
+	Texture* indexed;
+	std::vector<SDL_Point> pts;
+	std::vector<uint32_t> colors;
+	std::vector<Circle> shapes;
+
+	DrawBench() : Argon("Argon Benchmark", 800, 800, 0) {}
+
+	void onLoad(WindowEvent event) {
+		target = createTexture();
+		indexed = createTexture();
+		std::mt19937 rng(1);
+		for(uint32_t i = 0; i < count; ++i) {
+			pts.push_back({(int32_t)(rng() % ww()), (int32_t)(rng() % wh())});
+			colors.push_back(rng() % 8 < 7 ? 0xFFFFFFFF : 0xFF0000FF);
+			shapes.push_back({(float)pts[i].x, (float)pts[i].y, (float)(2 + rng() % 7), (uint32_t)rng() << 8 | 0x99});
+		}
+	}
+	void gameLoop(double dt) {
+		measure("argon.fillRect", iterations, [&] {
+			for(uint32_t i = 0; i < count; ++i) {fillRect(pts[i].x, pts[i].y, 4, 4, colors[i]);}
+			submit(*this);
+		});
+		measure("argon.addRect", iterations, [&] {
+			beginRects();
+			for(uint32_t i = 0; i < count; ++i) {addRect(pts[i].x, pts[i].y, 4, 4, colors[i]);}
+			endRects();
+			submit(*this);
+		});
+		measure("argon.line", iterations, [&] {
+			for(uint32_t i = 1; i < count; ++i) {line(pts[i-1].x, pts[i-1].y, pts[i].x, pts[i].y, colors[i]);}
+			submit(*this);
+		});
+		measure("argon.circles", iterations, [&] {
+			circles(shapes.data(), count);
+			submit(*this);
+		});
+		uint32_t color = 0x000000FF;
+		measure("argon.uploadFull", iterations, [&] {
+			Framebuffer fb = lockFramebuffer(target);
+			pixelFill(fb, color += 0x100);
+			fb.markAllDirty();
+			unlockFramebuffer(target, fb);
+		});
+		measure("argon.uploadDirty", iterations, [&] {
+			Framebuffer fb = lockFramebuffer(target);
+			pixelFillRect(fb, 100, 100, 64, 64, color += 0x100);
+			fb.markDirty(100, 100, 64, 64);
+			unlockFramebuffer(target, fb);
+		});
+		uint8_t index = 0;
+		measure("argon.uploadIndexed", iterations, [&] {
+			IndexedFramebuffer fb = lockIndexed(indexed);
+			for(int32_t y = 0; y < fb.h; ++y) {memset(fb.row(y), ++index, fb.w);}
+			fb.markAllDirty();
+			unlockIndexed(indexed, fb);
+		});
+		uint32_t palette[256];
+		measure("argon.setPalette", iterations, [&] {
+			for(uint32_t i = 0; i < 256; ++i) {palette[i] = (color += 0x100) | 0xFF;}
+			setPalette(indexed, palette);
+		});
+		measure("argon.drawTexture", iterations, [&] {
+			drawTexture(target);
+			submit(*this);
+		});
+		stop();
+	}
+};
+
+int main(int argc, char** argv) {
+	FILE* out = argc > 1 ? fopen(argv[1], "w") : stdout;
+	if(out == NULL) {
+		fprintf(stderr, "Failed to open %s\n", argv[1]);
+		return 1;
+	}
+	if(argc > 2) {iterations = std::max(atoi(argv[2]), 1);}
+	#ifdef _WIN32
+		_putenv_s("ARGON_HEADLESS", "1");
+	#else
+		setenv("ARGON_HEADLESS", "1", 1);
+	#endif
+
+	fprintf(stderr, "%-36s %8s %12s %12s\n", "kernel", "calls", "median ms", "min ms");
+	{ConwaysBench bench; bench.begin();}
+	{SandPilesBench bench; bench.begin();}
+	{DLABench bench; bench.begin();}
+	{FractalBench bench; bench.begin();}
+	{DrawBench bench; bench.begin();}
+
+	static constexpr const char* levelNames[3] = {"scalar", "sse2", "avx2"};
+	SDL_version version;
+	SDL_GetVersion(&version);
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"timestamp\": %lld,\n", (long long)time(NULL));
+	fprintf(out, "\t\"sdl\": \"%u.%u.%u\",\n", version.major, version.minor, version.patch);
+	fprintf(out, "\t\"simd\": \"%s\",\n", levelNames[Argon::getSimdLevel()]);
+	fprintf(out, "\t\"cpus\": %d,\n", SDL_GetCPUCount());
+	fprintf(out, "\t\"results\": [\n");
+	for(size_t i = 0; i < results.size(); ++i) {
+		const Result& r = results[i];
+		fprintf(out, "\t\t{\"name\": \"%s\", \"iterations\": %u, \"min_ms\": %.6f, \"median_ms\": %.6f, \"mean_ms\": %.6f, \"max_ms\": %.6f}%s\n",
+		        r.name.c_str(), r.iterations, r.minMs, r.medianMs, r.meanMs, r.maxMs, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "\t]\n}\n");
+	if(out != stdout) {fclose(out);}
+	return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Benchmark comparing per-call primitive drawing against the batched primitive API
+ * To compile run `g++ -std=c++17 -O3 -o batch batch.cpp -lSDL2`
+ * Usage: ./batch [primitives per frame] [frames per test]
+*/
+
+#include "../src/Argon.h"
+#include <cstdlib>
+
+struct BatchBench : public Argon {
+	static constexpr uint8_t NUM_TESTS = 8;
+	static constexpr const char* testNames[NUM_TESTS] = {"pixel", "point (batched)", "fillRect", "addRect (batched)", "rect", "addRect outline (batched)", "line", "vertex strip (batched)"};
+
+	uint32_t count;
+	uint32_t frames;
+	uint32_t frame = 0;
+	uint8_t test = 0;
+	uint64_t ticks = 0;
+	std::vector<SDL_Point> pts;
+	std::vector<uint32_t> colors;
+
+	BatchBench(uint32_t count, uint32_t frames) : Argon("Batch Benchmark", 800, 800, 0), count(count), frames(frames) {}
+
+	void onLoad(WindowEvent event) {
+		srand(1);
+		pts.resize(count);
+		colors.resize(count);
+		for(uint32_t i = 0; i < count; ++i) {
+			pts[i] = {rand() % ww(), rand() % wh()};
+			colors[i] = (rand() % 8 < 7) ? 0xFFFFFFFF : 0xFF0000FF; // mostly one color, like typical scenes
+		}
+		printf("%-28s %12s %12s\n", "test", "ms/frame", "Mprims/s");
+	}
+
+	void gameLoop(double dt) {
+		uint64_t start = SDL_GetPerformanceCounter();
+		switch(test) {
+			case 0: for(uint32_t i = 0; i < count; ++i) {pixel(pts[i].x, pts[i].y, colors[i]);} break;
+			case 1: beginPoints(); for(uint32_t i = 0; i < count; ++i) {point(pts[i].x, pts[i].y, colors[i]);} endPoints(); break;
+			case 2: for(uint32_t i = 0; i < count; ++i) {fillRect(pts[i].x, pts[i].y, 4, 4, colors[i]);} break;
+			case 3: beginRects(); for(uint32_t i = 0; i < count; ++i) {addRect(pts[i].x, pts[i].y, 4, 4, colors[i]);} endRects(); break;
+			case 4: for(uint32_t i = 0; i < count; ++i) {rect(pts[i].x, pts[i].y, 4, 4, colors[i]);} break;
+			case 5: beginRects(false); for(uint32_t i = 0; i < count; ++i) {addRect(pts[i].x, pts[i].y, 4, 4, colors[i]);} endRects(); break;
+			case 6: for(uint32_t i = 1; i < count; ++i) {line(pts[i-1].x, pts[i-1].y, pts[i].x, pts[i].y);} break;
+			case 7: beginLines(); for(uint32_t i = 0; i < count; ++i) {vertex(pts[i].x, pts[i].y);} endLines(); break;
+		}
+		ticks += SDL_GetPerformanceCounter() - start;
+
+		if(++frame == frames) {
+			double ms = ticks * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+			printf("%-28s %12.3f %12.2f\n", testNames[test], ms, count / ms / 1000.0);
+			frame = 0;
+			ticks = 0;
+			if(++test == NUM_TESTS) {stop();}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	uint32_t count = argc > 1 ? atoi(argv[1]) : 20000;
+	uint32_t frames = argc > 2 ? atoi(argv[2]) : 60;
+	BatchBench bench(count, frames);
+	bench.begin();
+	return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * Benchmark comparing SDL_gfx fillCircle() (like the dla example used) against instanced circles() and a Canvas
+ * To compile run `g++ -std=c++17 -O3 -o circles circles.cpp -lSDL2 -lSDL2_gfx`
+ * Usage: ./circles [frames per test]
+ * Times are measured from one frame to the next so they include submitting and presenting the frame
+*/
+
+#define ARGON_INCLUDE_GFX
+#include "../src/Argon.h"
+#include <cstdlib>
+
+struct CircleBench : public Argon {
+	static constexpr uint8_t NUM_METHODS = 4;
+	static constexpr const char* methodNames[NUM_METHODS] = {"fillCircle (SDL_gfx)", "circles()", "circles() anti-aliased", "Canvas fillCircle"};
+	static constexpr uint8_t NUM_COUNTS = 3;
+	static constexpr uint32_t counts[NUM_COUNTS] = {1000, 10000, 100000};
+
+	Texture* canvasTexture;
+	std::vector<Circle> shapes;
+	uint32_t frames;
+	uint32_t frame = 0;
+	uint8_t test = 0;
+	uint64_t last = 0;
+	uint64_t ticks = 0;
+
+	CircleBench(uint32_t frames) : Argon("Circle Benchmark", 800, 800, 0), frames(frames) {}
+
+	void onLoad(WindowEvent event) {
+		srand(1);
+		shapes.resize(counts[NUM_COUNTS - 1]);
+		for(Circle& c : shapes) {
+			c = {(float)(rand() % ww()), (float)(rand() % wh()), (float)(2 + rand() % 7), (uint32_t)rand() << 8 | 0x99};
+		}
+		canvasTexture = createTexture();
+		printf("%-24s %8s %12s %12s\n", "method", "circles", "ms/frame", "Mcircles/s");
+	}
+
+	void gameLoop(double dt) {
+		// The first frame of every test only starts the clock
+		uint64_t now = SDL_GetPerformanceCounter();
+		if(frame > 0) {ticks += now - last;}
+		last = now;
+
+		uint8_t method = test % NUM_METHODS;
+		uint32_t count = counts[test / NUM_METHODS];
+		switch(method) {
+			case 0: for(uint32_t i = 0; i < count; ++i) {fillCircle(shapes[i].x, shapes[i].y, shapes[i].radius, shapes[i].color);} break;
+			case 1: setAntiAlias(false); circles(shapes.data(), count); break;
+			case 2: setAntiAlias(true); circles(shapes.data(), count); break;
+			case 3: {
+				Canvas canvas = lockCanvas(canvasTexture);
+				canvas.clear(0x00000000);
+				for(uint32_t i = 0; i < count; ++i) {canvas.fillCircle(shapes[i].x, shapes[i].y, shapes[i].radius, shapes[i].color);}
+				unlockCanvas(canvasTexture, canvas);
+				drawTexture(canvasTexture);
+				break;
+			}
+		}
+
+		if(++frame == frames + 1) {
+			double ms = ticks * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+			printf("%-24s %8u %12.3f %12.2f\n", methodNames[method], count, ms, count / ms / 1000.0);
+			frame = 0;
+			ticks = 0;
+			if(++test == NUM_METHODS * NUM_COUNTS) {stop();}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	uint32_t frames = argc > 1 ? std::max(atoi(argv[1]), 1) : 20; // At least one frame per test, the times are averaged over them
+	CircleBench bench(frames);
+	bench.begin();
+	return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Benchmark comparing OpenMP per-pixel loops (like the examples used) against the tiled forEachPixel/forEachTile kernels
+ * To compile run `g++ -std=c++17 -O3 -fopenmp -o pixels pixels.cpp -lSDL2`
+ * Usage: ./pixels [frames per test]
+*/
+
+#include "../src/Argon.h"
+#include <cstdlib>
+
+struct PixelBench : public Argon {
+	static constexpr uint8_t NUM_METHODS = 4;
+	static constexpr const char* methodNames[NUM_METHODS] = {"serial", "omp parallel for", "forEachPixel", "forEachTile"};
+	static constexpr uint8_t NUM_KERNELS = 2;
+	static constexpr const char* kernelNames[NUM_KERNELS] = {"gradient", "mandelbrot"};
+
+	Texture* target;
+	uint32_t frames;
+	uint32_t frame = 0;
+	uint8_t test = 0;
+	uint64_t ticks = 0;
+
+	PixelBench(uint32_t frames) : Argon("Pixel Kernel Benchmark", 1024, 1024, 0), frames(frames) {}
+
+	void onLoad(WindowEvent event) {
+		target = createTexture();
+		printf("%-12s %-20s %12s %12s\n", "kernel", "method", "ms/frame", "Mpixels/s");
+	}
+
+	// Cheap kernel, memory bound
+	static inline void gradient(int32_t x, int32_t y, uint8_t* pixel) {
+		pixel[0] = x;
+		pixel[1] = y;
+		pixel[2] = x ^ y;
+		pixel[3] = 255;
+	}
+	// Expensive kernel with very uneven cost per pixel
+	static inline void mandelbrot(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t* pixel) {
+		float cx = -2.0f + 2.47f * x / w, cy = -1.0f + 2.0f * y / h;
+		float zx = 0, zy = 0;
+		uint16_t i = 0;
+		for(; i < 256 && zx * zx + zy * zy < 4; ++i) {
+			float t = zx * zx - zy * zy + cx;
+			zy = 2 * zx * zy + cy;
+			zx = t;
+		}
+		pixel[0] = pixel[1] = pixel[2] = i;
+		pixel[3] = 255;
+	}
+
+	void run(uint8_t method, uint8_t kernel) {
+		int32_t w, h, pitch;
+		if(method >= 2) {
+			if(method == 2 && kernel == 0) {forEachPixel(target, gradient);}
+			else if(method == 2) {forEachPixel(target, [&](int32_t x, int32_t y, uint8_t* pixel) {mandelbrot(x, y, ww(), wh(), pixel);});}
+			else {
+				const int32_t fw = ww(), fh = wh();
+				forEachTile(target, [&](int32_t x0, int32_t y0, Framebuffer& tile) {
+					for(int32_t y = 0; y < tile.h; ++y) {
+						uint8_t* pixel = tile.row(y);
+						for(int32_t x = 0; x < tile.w; ++x, pixel += 4) {
+							if(kernel == 0) {gradient(x0 + x, y0 + y, pixel);}
+							else {mandelbrot(x0 + x, y0 + y, fw, fh, pixel);}
+						}
+					}
+				});
+			}
+			return;
+		}
+		uint8_t* pixels = lockTexture(target, &w, &h, &pitch);
+		if(pixels == NULL) {return;}
+		if(method == 0) {
+			for(int32_t i = 0; i < w*h; ++i) {
+				if(kernel == 0) {gradient(i % w, i / w, &pixels[(i / w) * pitch + (i % w) * 4]);}
+				else {mandelbrot(i % w, i / w, w, h, &pixels[(i / w) * pitch + (i % w) * 4]);}
+			}
+		}
+		else {
+			#pragma omp parallel for schedule(dynamic)
+			for(int32_t i = 0; i < w*h; ++i) {
+				if(kernel == 0) {gradient(i % w, i / w, &pixels[(i / w) * pitch + (i % w) * 4]);}
+				else {mandelbrot(i % w, i / w, w, h, &pixels[(i / w) * pitch + (i % w) * 4]);}
+			}
+		}
+		unlockTexture(target);
+	}
+
+	void gameLoop(double dt) {
+		uint8_t method = test % NUM_METHODS, kernel = test / NUM_METHODS;
+		uint64_t start = SDL_GetPerformanceCounter();
+		run(method, kernel);
+		ticks += SDL_GetPerformanceCounter() - start;
+		drawTexture(target);
+
+		if(++frame == frames) {
+			double ms = ticks * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+			printf("%-12s %-20s %12.3f %12.2f\n", kernelNames[kernel], methodNames[method], ms, ww() * wh() / ms / 1000.0);
+			frame = 0;
+			ticks = 0;
+			if(++test == NUM_METHODS * NUM_KERNELS) {stop();}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	uint32_t frames = argc > 1 ? atoi(argv[1]) : 30;
+	PixelBench bench(frames);
+	bench.begin();
+	return 0;
+}
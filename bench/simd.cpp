@@ -0,0 +1,66 @@
+/**
+ * Benchmark of the pixel kernels (fill, fillRect, copy, blend, swizzle) on every SIMD level the CPU supports
+ * To compile run `g++ -std=c++17 -O3 -o simd simd.cpp -lSDL2`
+ * Usage: ./simd [iterations per test]
+*/
+
+#include "../src/Argon.h"
+#include <cstdlib>
+
+struct SimdBench : public Argon {
+	static constexpr uint8_t NUM_TESTS = 6;
+	static constexpr const char* testNames[NUM_TESTS] = {"fill", "fillRect", "copy", "blend", "RGBA->ARGB", "ARGB->RGBA"};
+	static constexpr const char* levelNames[3] = {"scalar", "sse2", "avx2"};
+
+	uint32_t iterations;
+	Texture* dst;
+
+	SimdBench(uint32_t iterations) : Argon("SIMD Benchmark", 1024, 1024, 0), iterations(iterations) {}
+
+	void onLoad(WindowEvent event) {
+		dst = createTexture();
+		fillTexture(dst, 0x000000FF);
+		printf("%-12s %-8s %12s %12s\n", "kernel", "level", "ms/iter", "GB/s");
+		for(uint8_t level = SIMD_SCALAR; level <= SIMD_AVX2; ++level) {
+			setSimdLevel((SimdLevel)level);
+			if(getSimdLevel() != level) {continue;}
+			for(uint8_t test = 0; test < NUM_TESTS; ++test) {run(test);}
+		}
+		stop();
+	}
+
+	void run(uint8_t test) {
+		Framebuffer d = {NULL, 0, 0, 0, {0, 0, 0, 0}}, s = {NULL, 0, 0, 0, {0, 0, 0, 0}};
+		d.pixels = lockTexture(dst, &d.w, &d.h, &d.pitch);
+		if(d.pixels == NULL) {return;}
+		std::vector<uint8_t> srcPixels((size_t)d.pitch * d.h);
+		s = {srcPixels.data(), d.w, d.h, d.pitch, {0, 0, 0, 0}};
+		pixelFill(s, 0x3C8CFF80);
+
+		// Bytes touched per iteration: fills only write, the others read and write
+		double bytes = (double)d.w * d.h * 4;
+		if(test == 1) {bytes = (double)(d.w - 2) * (d.h - 2) * 4;}
+		else if(test >= 2) {bytes *= 2;}
+		uint64_t start = SDL_GetPerformanceCounter();
+		for(uint32_t i = 0; i < iterations; ++i) {
+			switch(test) {
+				case 0: pixelFill(d, 0xFF0000FF + i); break;
+				case 1: pixelFillRect(d, 1, 1, d.w - 2, d.h - 2, 0x00FF00FF + i); break;
+				case 2: pixelCopy(d, s); break;
+				case 3: pixelBlend(d, s); break;
+				case 4: pixelRGBAtoARGB(d); break;
+				case 5: pixelARGBtoRGBA(d); break;
+			}
+		}
+		double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / iterations;
+		unlockTexture(dst);
+		printf("%-12s %-8s %12.3f %12.2f\n", testNames[test], levelNames[getSimdLevel()], ms, bytes / ms / 1e6);
+	}
+};
+
+int main(int argc, char** argv) {
+	uint32_t iterations = argc > 1 ? atoi(argv[1]) : 200;
+	SimdBench bench(iterations);
+	bench.begin();
+	return 0;
+}
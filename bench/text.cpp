@@ -0,0 +1,70 @@
+/**
+ * Benchmark comparing string() rendering every call with TTF_RenderText_Blended against the cached glyph atlas
+ * To compile run `g++ -std=c++17 -O3 -o text text.cpp -lSDL2 -lSDL2_ttf`
+ * Usage: ./text <font.ttf> [labels per frame] [frames per test]
+*/
+
+#define ARGON_INCLUDE_TTF
+#include "../src/Argon.h"
+#include <cstdlib>
+
+struct TextBench : public Argon {
+	static constexpr uint8_t NUM_TESTS = 2;
+	static constexpr const char* testNames[NUM_TESTS] = {"TTF_RenderText per call", "glyph atlas"};
+
+	const char* fontFile;
+	Font* font = NULL;
+	uint32_t count;
+	uint32_t frames;
+	uint32_t frame = 0;
+	uint8_t test = 0;
+	uint64_t ticks = 0;
+	char label[64];
+
+	TextBench(const char* fontFile, uint32_t count, uint32_t frames) : Argon("Text Benchmark", 800, 800, 0), fontFile(fontFile), count(count), frames(frames) {}
+
+	void onLoad(WindowEvent event) {
+		font = createFont(fontFile, 16);
+		if(font == NULL) {
+			fprintf(stderr, "Failed to open font %s\n", fontFile);
+			stop();
+			return;
+		}
+		printf("%-28s %12s %12s\n", "test", "ms/frame", "labels/ms");
+	}
+
+	void gameLoop(double dt) {
+		// A HUD like frame: short labels with changing numbers
+		setGlyphAtlas(test == 1);
+		uint64_t start = SDL_GetPerformanceCounter();
+		for(uint32_t i = 0; i < count; ++i) {
+			snprintf(label, sizeof(label), "Label %u: %u", i, frame * 31 + i);
+			string(label, font, (i % 4) * 200, (i / 4) * 18 % wh(), 0xFFFFFFFF);
+		}
+		setDeferred(false); // Submits the queued glyph quads so they are part of the measurement
+		ticks += SDL_GetPerformanceCounter() - start;
+
+		if(++frame == frames) {
+			double ms = ticks * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+			printf("%-28s %12.3f %12.2f\n", testNames[test], ms, count / ms);
+			frame = 0;
+			ticks = 0;
+			if(++test == NUM_TESTS) {
+				freeFont(font);
+				stop();
+			}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s <font.ttf> [labels per frame] [frames per test]\n", argv[0]);
+		return 1;
+	}
+	uint32_t count = argc > 2 ? atoi(argv[2]) : 50;
+	uint32_t frames = argc > 3 ? atoi(argv[3]) : 120;
+	TextBench bench(argv[1], count, frames);
+	bench.begin();
+	return 0;
+}
@@ -15,6 +15,7 @@
 #include "../src/Argon.h"
 #include <chrono>
 #include <bitset>
+#include <array>
 #include <vector>
 #include <initializer_list>
 
@@ -29,6 +30,10 @@ struct Brush {
 };
 
 
+enum CellState : uint8_t {
+	CELL_DEAD, CELL_ALIVE, CELL_BRUSH, CELL_UNKNOWN
+};
+
 struct Conways : public Argon {
 	static constexpr uint16_t SIZE = 51;
 	static constexpr uint8_t MIN_UPDATES_PER_SEC = 1;
@@ -51,17 +56,18 @@ struct Conways : public Argon {
 	bool playing = false;
 	std::bitset<SIZE*SIZE> data;
 	std::bitset<SIZE*SIZE> tmp;
+	std::array<CellState, SIZE*SIZE> cells;
+	bool wasPlaying = false;
 	uint32_t updatesPerSec = 8;
-	uint32_t msSinceUpdate = 0;
 
 	Conways() : Argon("Conway's Game of Life", 800, 800, ARGON_RESIZABLE|ARGON_HIGHDPI|ARGON_VSYNC) {}
 	void onLoad(WindowEvent event) {
-		frame = createTexture();
+		frame = createTexture(TEXTURE_NATIVE);
 		data.reset();
 		setMinSize(SIZE, SIZE);
+		setFixedTimestep(updatesPerSec);
 	}
 	void gameLoop(double dt) {
-		msSinceUpdate += (uint32_t)(dt*1000);
 		if(!playing) {
 			if(mouseDown()) {
 				const uint8_t ratio = ww() < wh() ? ww() / SIZE : wh() / SIZE;
@@ -79,24 +85,21 @@ struct Conways : public Argon {
 					}
 				}
 			}
-			msSinceUpdate = 0;
 		}
-		else if(msSinceUpdate >= 1000 / updatesPerSec) {
-			applyRules();
-			msSinceUpdate = 0;
-		}
-		render();
+	}
+	void simulate(double step) {
+		if(playing) {applyRules();}
 	}
 	void onKeyUp(KeyEvent event) {
 		switch(event.keycode) {
 			case SDLK_SPACE: playing = !playing; break;
 			case SDLK_PLUS:
 			case SDLK_EQUALS:
-				if(updatesPerSec < MAX_UPDATES_PER_SEC) {++updatesPerSec;}
+				if(updatesPerSec < MAX_UPDATES_PER_SEC) {setFixedTimestep(++updatesPerSec);}
 				break;
 			case SDLK_MINUS:
 			case SDLK_UNDERSCORE:
-				if(updatesPerSec > MIN_UPDATES_PER_SEC) {--updatesPerSec;}
+				if(updatesPerSec > MIN_UPDATES_PER_SEC) {setFixedTimestep(--updatesPerSec);}
 				break;
 			case SDLK_r:
 			case SDLK_RETURN:
@@ -159,65 +162,62 @@ struct Conways : public Argon {
 		}
 	}
 
-	void render() {
-		int32_t w, h;
-		uint8_t* pixels = lockTexture(frame, &w, &h);
-		if(pixels != NULL) {
-			const uint8_t ratio = w < h ? w / SIZE : h / SIZE;
+	void render(double alpha) {
+		Framebuffer fb = lockFramebuffer(frame);
+		if(fb.pixels != NULL) {
+			const uint8_t ratio = fb.w < fb.h ? fb.w / SIZE : fb.h / SIZE;
 			const uint32_t boardSize = ratio * SIZE;
-			const uint32_t xPad = (w - boardSize) / 2;
-			const uint32_t yPad = (h - boardSize) / 2;
-			const float maxd = boardSize * boardSize * 2;
+			const uint32_t xPad = (fb.w - boardSize) / 2;
+			const uint32_t yPad = (fb.h - boardSize) / 2;
 			const uint32_t dmx = (mx()-xPad) / ratio;
 			const uint32_t dmy = (my()-yPad) / ratio;
 
-			uint32_t dx, dy;
-			for(uint32_t y = 0; y < boardSize; ++y) {
-				dy = y / ratio;
-				for(uint32_t x = 0; x < boardSize; ++x) {
-					dx = x / ratio;
-					uint8_t* px = &pixels[((y+yPad) * w + (x+xPad)) * 4];
-					if(!playing && ratio > 3 && (y % (uint32_t)ratio == 0 || x % (uint32_t)ratio == 0)) {
-						px[0] = 64;
-						px[1] = 64;
-						px[2] = 64;
-						px[3] = 255;
-					}
-					else if(data[dy * SIZE + dx]) {
-						uint32_t color = playing ? hsla2rgba(MAP(x*x+y*y, 0, maxd, 0, 360), 1.0, 0.50) : 0xFFFFFFFF;
-						px[0] = (color >> 24) & 0xFF;
-						px[1] = (color >> 16) & 0xFF;
-						px[2] = (color >> 7) & 0xFF;
-						px[3] = color & 0xFF;
-					}
-					else if(!playing && (dx >= dmx && dy >= dmy && dx < dmx+brush->w && dy < dmy+brush->h && brush->data[(dy - dmy) * brush->w + (dx - dmx)])) {
-						px[0] = 128;
-						px[1] = 128;
-						px[2] = 128;
-						px[3] = 255;
-					}
-					else {
-						px[0] = 0;
-						px[1] = 0;
-						px[2] = 0;
-						px[3] = 255;
+			// The framebuffer keeps its contents, so only cells that look different from last frame are redrawn & uploaded
+			if(fb.isDirty() || playing != wasPlaying) {
+				pixelFill(fb, 0x00000000);
+				cells.fill(CELL_UNKNOWN);
+				fb.markAllDirty();
+				wasPlaying = playing;
+			}
+			for(uint32_t dy = 0; dy < SIZE; ++dy) {
+				for(uint32_t dx = 0; dx < SIZE; ++dx) {
+					CellState state = CELL_DEAD;
+					if(data[dy * SIZE + dx]) {state = CELL_ALIVE;}
+					else if(!playing && (dx >= dmx && dy >= dmy && dx < dmx+brush->w && dy < dmy+brush->h && brush->data[(dy - dmy) * brush->w + (dx - dmx)])) {state = CELL_BRUSH;}
+					if(cells[dy * SIZE + dx] != state) {
+						cells[dy * SIZE + dx] = state;
+						renderCell(fb, dx, dy, state, ratio, boardSize, xPad, yPad);
+						fb.markDirty(xPad + dx * ratio, yPad + dy * ratio, ratio, ratio);
 					}
-					
 				}
 			}
+
 			//Borders
-			for(uint32_t x = 0; x < boardSize; ++x) {
-				memset(&pixels[((yPad) * w + (x+xPad))*4], 255, 4);
-				memset(&pixels[((h-yPad-1) * w + (x+xPad))*4], 255, 4);
-			}
-			for(uint32_t y = 0; y < boardSize; ++y) {
-				memset(&pixels[((y+yPad) * w + (xPad))*4], 255, 4);
-				memset(&pixels[((y+yPad) * w + (w-xPad-1))*4], 255, 4);
+			if(fb.dirty.w == fb.w && fb.dirty.h == fb.h) {
+				pixelFillRect(fb, xPad, yPad, boardSize, 1, 0xFFFFFFFF);
+				pixelFillRect(fb, xPad, fb.h-yPad-1, boardSize, 1, 0xFFFFFFFF);
+				pixelFillRect(fb, xPad, yPad, 1, boardSize, 0xFFFFFFFF);
+				pixelFillRect(fb, fb.w-xPad-1, yPad, 1, boardSize, 0xFFFFFFFF);
 			}
 		}
-		unlockTexture(frame);
+		unlockFramebuffer(frame, fb);
 		drawTexture(frame);
-	}	
+	}
+	void renderCell(Framebuffer& fb, uint32_t dx, uint32_t dy, CellState state, uint8_t ratio, uint32_t boardSize, uint32_t xPad, uint32_t yPad) {
+		const float maxd = boardSize * boardSize * 2;
+		for(uint32_t y = dy * ratio; y < (dy + 1) * ratio; ++y) {
+			// Skip the border so it doesn't need to be redrawn
+			if(y + yPad == yPad || y + yPad == fb.h-yPad-1) {continue;}
+			for(uint32_t x = dx * ratio; x < (dx + 1) * ratio; ++x) {
+				if(x + xPad == xPad || x + xPad == fb.w-xPad-1) {continue;}
+				// The texture is in the renderer's native channel order, set() converts the 0xRRGGBBAA colors
+				if(!playing && ratio > 3 && (y % (uint32_t)ratio == 0 || x % (uint32_t)ratio == 0)) {fb.set(x+xPad, y+yPad, 0x404040FF);}
+				else if(state == CELL_ALIVE) {fb.set(x+xPad, y+yPad, playing ? hsla2rgba(MAP(x*x+y*y, 0, maxd, 0, 360), 1.0, 0.50) : 0xFFFFFFFF);}
+				else if(state == CELL_BRUSH) {fb.set(x+xPad, y+yPad, 0x808080FF);}
+				else {fb.set(x+xPad, y+yPad, 0x000000FF);}
+			}
+		}
+	}
 };
 
 const Brush Conways::pointBrush = {1, 1, {1}};
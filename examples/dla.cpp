@@ -1,10 +1,9 @@
 /**
  * Example created by Owen Kuhn (author of Argon)
- * To compile run `g++ -std=c++17 -Xpreprocessor -O3 -o dla dla.cpp -lSDL2 -lSDL2_gfx -lomp`
+ * To compile run `g++ -std=c++17 -O3 -o dla dla.cpp -lSDL2 -pthread`
  * Diffusion-limited aggregation (from: https://www.youtube.com/watch?v=Cl_Gjj80gPE)
 */
 
-#define ARGON_INCLUDE_GFX
 #include "../src/Argon.h"
 #include <vector>
 #include <random>
@@ -29,8 +28,8 @@ struct Walker {
 	
 	Walker(int16_t _x, int16_t _y, bool _frozen = false) : x(_x), y(_y), frozen(_frozen) {}
 
-	void draw(Argon& argon) {
-		argon.fillCircle(static_cast<int32_t>(x), static_cast<int32_t>(y), radius, frozen ? color : 0xFFFFFFFF);
+	Circle shape() const {
+		return {x, y, (float)radius, frozen ? color : 0xFFFFFFFF};
 	}
 
 	void move(int32_t w, int32_t h) {
@@ -43,7 +42,6 @@ struct Walker {
 	}
 
 	bool checkFrozen(std::vector<Walker>& others) {
-		#pragma omp parallel for schedule(dynamic)
 		for(Walker& other : others) {
 			float d2 = (x - other.x) * (x - other.x) + (y - other.y) * (y - other.y);
 			float collideDist = (radius * radius) + (other.radius * other.radius) + (2 * other.radius * radius);
@@ -68,10 +66,12 @@ std::uniform_real_distribution<float> Walker::vectorDist(-1, 1);
 
 
 struct DLA : public Argon {
-	Texture* frame;
+	Layer* cluster;
+	size_t drawnFrozen = 0;
 
 	std::vector<Walker> frozen;
 	std::vector<Walker> walking;
+	std::vector<Circle> shapes;
 
 	std::uniform_int_distribution<int> perimiterDistribution;
 
@@ -82,7 +82,7 @@ struct DLA : public Argon {
 	void onLoad(WindowEvent event) {
 		frozen.reserve(MAX_WALKERS);
 		walking.reserve(MAX_WALKERS);
-		setAntiAlias(true);
+		cluster = createLayer();
 
 		// Create first seed
 		frozen.emplace_back(ww()/2, wh()/2, true);
@@ -94,25 +94,46 @@ struct DLA : public Argon {
 	}
 
 	void gameLoop(double dt) {
-		for(uint16_t i = 0; i < ITERATIONS_PER_FRAME; ++i) {
-			for(auto it = walking.begin(); it != walking.end();) {
-				it->move(ww(), wh());
-				if(it->checkFrozen(frozen)) {
-					it->setFrozenColor(*this);
-					frozen.emplace_back((Walker&&) *it);
-					it = walking.erase(it);	
-					break;
-				}
-				else {++it;}
+		for(uint16_t i = 0; i < ITERATIONS_PER_FRAME; ++i) {step();}
+		drawFrame();
+		while(frozen.size() < MAX_FROZEN && walking.size() < MAX_WALKERS) {spawnWalker();}
+	}
+
+	void step() {
+		// Moves every walker once, stopping at the first one that sticks to the aggregate
+		for(auto it = walking.begin(); it != walking.end();) {
+			it->move(ww(), wh());
+			if(it->checkFrozen(frozen)) {
+				it->setFrozenColor(*this);
+				frozen.emplace_back((Walker&&) *it);
+				it = walking.erase(it);	
+				break;
 			}
+			else {++it;}
 		}
-		for(Walker& walker : frozen) {
-			walker.draw(*this);
+	}
+
+	void drawFrame() {
+		// Frozen walkers never move, so only the ones frozen since the last frame are added to the cluster layer
+		if(cluster == NULL) {drawWalkers(frozen, 0);}
+		else if(isLayerDirty(cluster) || drawnFrozen < frozen.size()) {
+			size_t from = isLayerDirty(cluster) ? 0 : drawnFrozen;
+			beginLayer(cluster, false);
+			drawWalkers(frozen, from);
+			endLayer();
+			drawnFrozen = frozen.size();
 		}
-		for(Walker& walker : walking) {
-			walker.draw(*this);
+		// Walkers move over the cluster
+		drawLayers();
+		drawWalkers(walking, 0);
+	}
+
+	void drawWalkers(const std::vector<Walker>& walkers, size_t from) {
+		shapes.clear();
+		for(size_t i = from; i < walkers.size(); ++i) {
+			shapes.push_back(walkers[i].shape());
 		}
-		while(frozen.size() < MAX_FROZEN && walking.size() < MAX_WALKERS) {spawnWalker();}
+		circles(shapes.data(), shapes.size());
 	}
 
 	void spawnWalker() {
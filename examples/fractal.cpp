@@ -2,7 +2,7 @@
  * Example created by Owen Kuhn (author of Argon)
  * https://en.wikipedia.org/wiki/Mandelbrot_set
  * https://en.wikipedia.org/wiki/Julia_set
- * To compile run `g++ -std=c++17 -Xpreprocessor -O3 -o fractal fractal.cpp -lSDL2 -lomp`
+ * To compile run `g++ -std=c++17 -O3 -o fractal fractal.cpp -lSDL2 -pthread`
  * CONTROLS
  * Translate Fractal: arrow keys, WASD, click + drag
  * Zoom Fractal: +/- keys, scroll
@@ -12,11 +12,11 @@
  * Toggle Color Scheme: Shift
  * Right Click: set orbit trap point at location
  * Reset Fractal: zero '0' key
+ * Toggle Profiler Overlay: P
 */
 
 #include "../src/Argon.h"
 #include <cmath>
-#include <chrono>
 
 typedef long double F;
 #define MAP(x, a, b, c, d) ((F)(c) + (((F)(d) - (F)(c)) / ((F)(b) - (F)(a))) * ((F)(x) - (F)(a)))
@@ -36,29 +36,12 @@ enum FRACTAL_TYPE : uint8_t {
 	MANDELBROT, JULIA
 };
 
-
-// Fractal Class
-struct FractalVisualizer : public Argon {
-	//Settings
-	static constexpr F arrowStep = 5.0;
-	static constexpr F zoomFactor = 1.1;
-	static constexpr F rotateFactor = 0.05;
-
+// View & fractal math, everything fillPixels() reads so it can be copied before every fill
+struct FractalView {
 	// Variables
-	Texture* frame;
 	F scale = 1;
 	F tx = 0;
 	F ty = 0;
-	struct {
-		bool left  : 1;
-		bool up    : 1;
-		bool right : 1;
-		bool down  : 1;
-		bool minus : 1;
-		bool plus  : 1;
-		bool q     : 1;
-		bool e     : 1;
-	} keys;
 
 	//Enums
 	FRACTAL_TYPE fractalType = MANDELBROT;
@@ -73,37 +56,124 @@ struct FractalVisualizer : public Argon {
 	F orbitPoint[2] = {0, 0};
 	F size[2] = {2.47, 2};
 
+	inline void runFractal(int32_t& w, int32_t& h, uint32_t& i, uint32_t& iterations, COLOR_METHOD& colorMethod, F& distance) {
+		switch(fractalType) {
+			case MANDELBROT: mandelbrot(w, h, i, iterations, colorMethod, distance); break;
+			case JULIA: julia(w, h, i, iterations, colorMethod, distance); break;
+		}
+	}
+	inline void colorPixel(uint8_t* pixel, F& value, F& max) {
+		switch(colorPalette) {
+			case THERMAL: {
+				uint8_t* color = thermal[(int)MAP(value, 0, max, 0, THERMAL_LENGTH)];
+				pixel[0] = color[0];
+				pixel[1] = color[1];
+				pixel[2] = color[2];
+				break;
+			}
+			case RGB: {
+				uint32_t color = hsla2rgba(MAP(value, 0, max, 0, 359), 1.0, 0.50);
+				pixel[0] = (uint8_t)(color >> 24);
+				pixel[1] = (uint8_t)(color >> 16);
+				pixel[2] = (uint8_t)(color >> 8);
+				break;
+			}
+			case BW: {
+				memset(pixel, (uint8_t)round(MAP(value, 0, max, 0, 255)), 3);
+				break;
+			}
+		}
+		pixel[3] = 255;
+	}
+
+	// Fractals
+	void mandelbrot(int32_t& w, int32_t& h, uint32_t& i, uint32_t& iterations, COLOR_METHOD& colorMethod, F& distance) {
+		iterations = 0;
+		distance = maxDistance;
+		F x0 = MAP(i%w, 0, w, params[0] * scale + tx, params[1] * scale + tx);
+		F y0 = MAP(i/w, 0, h, params[2] * scale + ty, params[3] * scale + ty);
+		F x = 0, y = 0, x2 = 0, y2 = 0, d = 0;
+		while(x2 + y2 <= 4 && iterations < maxIterations) {
+			y = (x + x) * y + y0;
+			x = x2 - y2 + x0;
+			x2 = x * x;
+			y2 = y * y;
+
+			if(colorMethod == POINT_ORBIT_TRAP) {
+				d = sqrt((x2 - (orbitPoint[0] * orbitPoint[0])) + (y2 - (orbitPoint[1] * orbitPoint[1])));
+				if(d < distance) {
+					distance = d;
+				}
+			}
+			++iterations;
+		}
+	}
+	void julia(int32_t& w, int32_t& h, uint32_t& i, uint32_t& iterations, COLOR_METHOD& colorMethod, F& distance) {
+		iterations = 0;
+		distance = maxDistance;
+		F x = MAP(i%w, 0, w, -params[2] * scale + tx, params[2] * scale + tx);
+		F y = MAP(i/w, 0, h, -params[2] * scale + ty, params[2] * scale + ty);
+		F x2 = x*x, y2 = y*y, d = 0;
+		while(x2 + y2 <= params[2] && iterations < maxIterations) {
+			y = (x + x) * y  + params[1];
+			x = x2 - y2 + params[0];
+
+			x2 = x * x;
+			y2 = y * y;
+			if(colorMethod == POINT_ORBIT_TRAP) {
+				d = sqrt((x2 - (orbitPoint[0] * orbitPoint[0])) + (y2 - (orbitPoint[1] * orbitPoint[1])));
+				if(d < distance) {
+					distance = d;
+				}
+			}
+			++iterations;
+		}
+		// iterations = maxIterations - iterations;
+	}
+};
+
+
+// Fractal Class
+struct FractalVisualizer : public Argon, public FractalView {
+	//Settings
+	static constexpr F arrowStep = 5.0;
+	static constexpr F zoomFactor = 1.1;
+	static constexpr F rotateFactor = 0.05;
+
+	// Variables
+	Texture* frame;
+	FractalView filling; // The view fillPixels() computes, input keeps changing the app's own view while it runs
+
 	FractalVisualizer() : Argon("Fractal Visualizer", ARGON_RESIZABLE|ARGON_HIGHDPI|ARGON_VSYNC) {}
 	void onLoad(WindowEvent event) {
-		frame = createTexture();
+		frame = createTexture(TEXTURE_POW2);
+		setAsyncFramebuffer(frame); // Fractal is computed in fillPixels() on a background thread
 		renderFractal();
-		memset(&keys, 0, sizeof(keys));
+		setOnDemand(true); // Only redraw on input, the fractal doesn't change on its own
+		setCoalesceMotion(true); // One onMouseMove per frame while dragging
 	}
 	void onUnload(WindowEvent event) {
 
 	}
 	void gameLoop(double dt) {
+		const InputState& input = getInput();
 		bool changes = false;
-		if(keys.left)  {tx    -= arrowStep  * scale * dt;changes = true;}
-		if(keys.up)    {ty    -= arrowStep  * scale * dt;changes = true;}
-		if(keys.right) {tx    += arrowStep  * scale * dt;changes = true;}
-		if(keys.down)  {ty    += arrowStep  * scale * dt;changes = true;}
-		if(keys.minus) {scale += zoomFactor * scale * dt;changes = true;}
-		if(keys.plus)  {scale -= zoomFactor * scale * dt;changes = true;}
-		if(keys.q)     {angle -= rotateFactor; changes = true;}
-		if(keys.e)     {angle += rotateFactor; changes = true;}
-		if(changes)    {renderFractal();}
+		if(input.key(SDL_SCANCODE_LEFT) || input.key(SDL_SCANCODE_A))  {tx    -= arrowStep  * scale * dt;changes = true;}
+		if(input.key(SDL_SCANCODE_UP) || input.key(SDL_SCANCODE_W))    {ty    -= arrowStep  * scale * dt;changes = true;}
+		if(input.key(SDL_SCANCODE_RIGHT) || input.key(SDL_SCANCODE_D)) {tx    += arrowStep  * scale * dt;changes = true;}
+		if(input.key(SDL_SCANCODE_DOWN) || input.key(SDL_SCANCODE_S))  {ty    += arrowStep  * scale * dt;changes = true;}
+		if(input.key(SDL_SCANCODE_MINUS))  {scale += zoomFactor * scale * dt;changes = true;}
+		if(input.key(SDL_SCANCODE_EQUALS)) {scale -= zoomFactor * scale * dt;changes = true;}
+		if(input.key(SDL_SCANCODE_Q))      {angle -= rotateFactor; changes = true;}
+		if(input.key(SDL_SCANCODE_E))      {angle += rotateFactor; changes = true;}
+		if(changes)    {renderFractal(); requestRedraw();}
 		drawTexture(frame);
 	}
 	void onKeyDown(KeyEvent event) {
-		if(event.keycode == SDLK_LEFT || event.keycode == SDLK_a) {keys.left = true;}
-		else if(event.keycode == SDLK_UP || event.keycode == SDLK_w) {keys.up = true;}
-		else if(event.keycode == SDLK_DOWN || event.keycode == SDLK_s) {keys.down = true;}
-		else if(event.keycode == SDLK_RIGHT || event.keycode == SDLK_d) {keys.right = true;}
-		else if(event.keycode == SDLK_MINUS) {keys.minus = true;}
-		else if(event.keycode == SDLK_EQUALS) {keys.plus = true;}
-		else if(event.keycode == SDLK_q) {keys.q = true;}
-		else if(event.keycode == SDLK_e) {keys.e = true;}
+		if(event.keycode == SDLK_p) {
+			setProfilerOverlay(!isShowingProfiler());
+			requestRedraw();
+		}
 		else if(event.keycode == SDLK_0) {
 			if(scale != 1 || tx != 0 || ty != 0) {
 				resetFractal();
@@ -124,16 +194,6 @@ struct FractalVisualizer : public Argon {
 			renderFractal();
 		}
 	}
-	void onKeyUp(KeyEvent event) {
-		if(event.keycode == SDLK_LEFT || event.keycode == SDLK_a) {keys.left = false;}
-		else if(event.keycode == SDLK_UP || event.keycode == SDLK_w) {keys.up = false;}
-		else if(event.keycode == SDLK_DOWN || event.keycode == SDLK_s) {keys.down = false;}
-		else if(event.keycode == SDLK_RIGHT || event.keycode == SDLK_d) {keys.right = false;}
-		else if(event.keycode == SDLK_MINUS) {keys.minus = false;}
-		else if(event.keycode == SDLK_EQUALS) {keys.plus = false;}
-		else if(event.keycode == SDLK_q) {keys.q = false;}
-		else if(event.keycode == SDLK_e) {keys.e = false;}
-	}
 	void onWindowResize(WindowEvent event) {
 		renderFractal();
 	} 
@@ -188,104 +248,26 @@ struct FractalVisualizer : public Argon {
 		}
 	}
 	void renderFractal() {
-		// auto start = std::chrono::high_resolution_clock::now();
-		int32_t w, h;
-		uint8_t* pixels = lockTexture(frame, &w, &h);
-		if(pixels != NULL) {
-			if(fractalType == JULIA) {
-				params[0] = 0.7885 * cos(angle); 
-				params[1] = 0.7885 * sin(angle);
-			}
-			#pragma omp parallel for schedule(dynamic)
-			for(uint32_t i = 0; i < w*h; ++i) {
-				uint32_t iterations;
-				F distance;
-				runFractal(w, h, i, iterations, colorMethod, distance);
-				F v, max;
-				switch(colorMethod) {
-					case ITERATIONS: v = iterations; max = maxIterations; break;
-					case POINT_ORBIT_TRAP: v = distance; max = maxDistance; break;
-				}
-				colorPixel(&pixels[i*4], v, max);
-			}
-			unlockTexture(frame);
-			// auto end = std::chrono::high_resolution_clock::now();
-			// printf("Took: %lldms\n", std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+		if(fractalType == JULIA) {
+			params[0] = 0.7885 * cos(angle); 
+			params[1] = 0.7885 * sin(angle);
 		}
+		requestPixels();
 	}
-	inline void runFractal(int32_t& w, int32_t& h, uint32_t& i, uint32_t& iterations, COLOR_METHOD& colorMethod, F& distance) {
-		switch(fractalType) {
-			case MANDELBROT: mandelbrot(w, h, i, iterations, colorMethod, distance); break;
-			case JULIA: julia(w, h, i, iterations, colorMethod, distance); break;
-		}
-	}
-	inline void colorPixel(uint8_t* pixel, F& value, F& max) {
-		switch(colorPalette) {
-			case THERMAL: {
-				uint8_t* color = thermal[(int)MAP(value, 0, max, 0, THERMAL_LENGTH)];
-				pixel[0] = color[0];
-				pixel[1] = color[1];
-				pixel[2] = color[2];
-				break;
+	void preparePixels() {filling = *this;}
+	void fillPixels(Framebuffer& fb) {
+		int32_t w = fb.w, h = fb.h;
+		forEachPixel(fb, [&](int32_t x, int32_t y, uint8_t* pixel) {
+			uint32_t i = y * w + x, iterations;
+			F distance;
+			filling.runFractal(w, h, i, iterations, filling.colorMethod, distance);
+			F v, max;
+			switch(filling.colorMethod) {
+				case ITERATIONS: v = iterations; max = filling.maxIterations; break;
+				case POINT_ORBIT_TRAP: v = distance; max = filling.maxDistance; break;
 			}
-			case RGB: {
-				uint32_t color = hsla2rgba(MAP(value, 0, max, 0, 359), 1.0, 0.50);
-				pixel[0] = (uint8_t)(color >> 24);
-				pixel[1] = (uint8_t)(color >> 16);
-				pixel[2] = (uint8_t)(color >> 8);
-				break;
-			}
-			case BW: {
-				memset(pixel, (uint8_t)round(MAP(value, 0, max, 0, 255)), 3);
-				break;
-			}
-		}
-		pixel[3] = 255;
-	}
-
-	// Fractals
-	void mandelbrot(int32_t& w, int32_t& h, uint32_t& i, uint32_t& iterations, COLOR_METHOD& colorMethod, F& distance) {
-		iterations = 0;
-		distance = maxDistance;
-		F x0 = MAP(i%w, 0, w, params[0] * scale + tx, params[1] * scale + tx);
-		F y0 = MAP(i/w, 0, h, params[2] * scale + ty, params[3] * scale + ty);
-		F x = 0, y = 0, x2 = 0, y2 = 0, d = 0;
-		while(x2 + y2 <= 4 && iterations < maxIterations) {
-			y = (x + x) * y + y0;
-			x = x2 - y2 + x0;
-			x2 = x * x;
-			y2 = y * y;
-
-			if(colorMethod == POINT_ORBIT_TRAP) {
-				d = sqrt((x2 - (orbitPoint[0] * orbitPoint[0])) + (y2 - (orbitPoint[1] * orbitPoint[1])));
-				if(d < distance) {
-					distance = d;
-				}
-			}
-			++iterations;
-		}
-	}
-	void julia(int32_t& w, int32_t& h, uint32_t& i, uint32_t& iterations, COLOR_METHOD& colorMethod, F& distance) {
-		iterations = 0;
-		distance = maxDistance;
-		F x = MAP(i%w, 0, w, -params[2] * scale + tx, params[2] * scale + tx);
-		F y = MAP(i/w, 0, h, -params[2] * scale + ty, params[2] * scale + ty);
-		F x2 = x*x, y2 = y*y, d = 0;
-		while(x2 + y2 <= params[2] && iterations < maxIterations) {
-			y = (x + x) * y  + params[1];
-			x = x2 - y2 + params[0];
-
-			x2 = x * x;
-			y2 = y * y;
-			if(colorMethod == POINT_ORBIT_TRAP) {
-				d = sqrt((x2 - (orbitPoint[0] * orbitPoint[0])) + (y2 - (orbitPoint[1] * orbitPoint[1])));
-				if(d < distance) {
-					distance = d;
-				}
-			}
-			++iterations;
-		}
-		// iterations = maxIterations - iterations;
+			filling.colorPixel(pixel, v, max);
+		});
 	}
 };
 
@@ -1,7 +1,7 @@
 /**
  * Example created by Owen Kuhn (author of Argon)
  * https://en.wikipedia.org/wiki/Abelian_sandpile_model
- * To compile run `g++ -std=c++17 -Xpreprocessor -O3 -o sandpiles sandpiles.cpp -lSDL2 -lomp`
+ * To compile run `g++ -std=c++17 -O3 -o sandpiles sandpiles.cpp -lSDL2 -pthread`
  * CONTROLS
  * Add 1 grain of sand: click
  * Clear table: 0 key or R key
@@ -11,6 +11,7 @@
  * Place a lot of sand at the center: 4 key
  * Increase iterations per frame (faster): +
  * Decrease iterations per frame (slower): - 
+ * Swap color palette: P key
 */
 
 #include "../src/Argon.h"
@@ -20,38 +21,37 @@ struct SandPiles : public Argon {
 	static constexpr uint16_t w = 600;
 	static constexpr uint16_t h = 600;
 	static constexpr uint32_t spawnRate = 100;
-	// static constexpr uint32_t colorPalette[5] = {0x311E10FF, 0xECE4B7FF, 0xEABE7CFF, 0xD9DD92FF, 0xDD6031FF};
-	static constexpr uint32_t colorPalette[5] = {0x000000FF, 0x14007BFF, 0x9D009BFF, 0xF78500FF, 0xFFFEEFFF};
+	static constexpr uint32_t colorPalettes[2][5] = {
+		{0x000000FF, 0x14007BFF, 0x9D009BFF, 0xF78500FF, 0xFFFEEFFF},
+		{0x311E10FF, 0xECE4B7FF, 0xEABE7CFF, 0xD9DD92FF, 0xDD6031FF}
+	};
 
 	Texture* frame;
 	std::chrono::time_point<std::chrono::high_resolution_clock> lastAddition;
 	uint16_t topplePerFrame = 12;
+	uint8_t palette = 0;
 	uint32_t* sand;
 	uint32_t* tmp;
-
-	struct {
-		bool minus : 1;
-		bool plus : 1;
-	} keys;
-
+	std::vector<uint8_t> changedRows = std::vector<uint8_t>(h);
 
 	SandPiles() : Argon("Sand Piles", w, h, ARGON_HIGHDPI|ARGON_VSYNC) {}
 	void onLoad(WindowEvent event) {
 		frame = createTexture();
+		setPalette(frame, colorPalettes[palette], 5); // Cells store 0-4 grains, Argon turns them into colors when uploading
 
 		sand = new uint32_t[w*h];
 		tmp = new uint32_t[w*h];
-		memset(&keys, 0, sizeof(keys));
 		setSand(sand, 0);
 
 		lastAddition = std::chrono::high_resolution_clock::now();
 	}
 	void gameLoop(double dt) {
 		if(mouseDown()) {addSand(mx(), my());}
-		if(keys.plus && !keys.minus) {
+		const InputState& input = getInput();
+		if(input.key(SDL_SCANCODE_EQUALS) && !input.key(SDL_SCANCODE_MINUS)) {
 			topplePerFrame += 2;
 		}
-		else if(keys.minus && !keys.plus) {
+		else if(input.key(SDL_SCANCODE_MINUS) && !input.key(SDL_SCANCODE_EQUALS)) {
 			topplePerFrame -= 2;
 		}
 
@@ -61,20 +61,10 @@ struct SandPiles : public Argon {
 		updateTexture();
 		drawTexture(frame);
 	}
-	void onKeyDown(KeyEvent event) {
-		if(event.keycode == SDLK_MINUS) {
-			keys.minus = true;
-		}
-		else if(event.keycode == SDLK_EQUALS) {
-			keys.plus = true;
-		}
-	}
 	void onKeyUp(KeyEvent event) {
-		if(event.keycode == SDLK_MINUS) {
-			keys.minus = false;
-		}
-		else if(event.keycode == SDLK_EQUALS) {
-			keys.plus = false;
+		if(event.keycode == SDLK_p) {
+			palette = (palette + 1) % 2;
+			setPalette(frame, colorPalettes[palette], 5);
 		}
 		else if(event.keycode == SDLK_r || event.keycode == SDLK_0) {
 			setSand(sand, 0);
@@ -102,23 +92,21 @@ struct SandPiles : public Argon {
 	}
 
 	bool topple() {
-		bool changes = false;
-		setSand(tmp, 0);
-
-		for(uint32_t y = 0;y < h; ++y) {
+		// Each cell gathers the grains its toppling neighbors give it, so rows can be computed in parallel
+		std::atomic<bool> changes{false};
+		parallelFor(0, h, [this, &changes](int32_t y) {
+			bool rowChanges = false;
 			for(uint32_t x = 0;x < w; ++x) {
 				size_t i = y * w + x;
-				tmp[i] += sand[i];
-				if(sand[i] >= 4) {
-					tmp[i] -= 4;
-					if(x > 0) {++tmp[i-1];}
-					if(x < w-1) {++tmp[i+1];}
-					if(y > 0) {++tmp[i-w];}
-					if(y < h-1) {++tmp[i+w];}
-					changes = true;
-				}
+				tmp[i] = sand[i] >= 4 ? sand[i] - 4 : sand[i];
+				if(x > 0 && sand[i-1] >= 4) {++tmp[i];}
+				if(x < w-1 && sand[i+1] >= 4) {++tmp[i];}
+				if(y > 0 && sand[i-w] >= 4) {++tmp[i];}
+				if(y < h-1 && sand[i+w] >= 4) {++tmp[i];}
+				rowChanges |= sand[i] >= 4;
 			}
-		}	
+			if(rowChanges) {changes = true;}
+		});
 
 		uint32_t* _tmp = sand;
 		sand = tmp;
@@ -127,26 +115,28 @@ struct SandPiles : public Argon {
 	}
 
 	void updateTexture() {
-		int32_t w, h;
-		uint8_t* pixels = lockTexture(frame, &w, &h);
-		if(pixels != NULL) {
-			#pragma omp parallel for schedule(dynamic)
-			for(size_t i = 0;i < w*h; ++i) {
-				uint32_t color = sand[i] >= 4 ? colorPalette[4] : colorPalette[sand[i]];
-				pixels[i*4] = (color >> 24) & 0xFF;
-				pixels[i*4+1] = (color >> 16) & 0xFF;
-				pixels[i*4+2] = (color >> 8) & 0xFF;
-				pixels[i*4+3] = color & 0xFF;
+		// Only the rows whose indices changed are expanded and uploaded
+		IndexedFramebuffer fb = lockIndexed(frame);
+		if(fb.pixels != NULL && fb.w == w && fb.h == h) {
+			parallelFor(0, h, [&](int32_t y) {
+				uint8_t* row = fb.row(y);
+				uint8_t changed = 0;
+				for(uint32_t x = 0; x < w; ++x) {
+					uint8_t index = std::min<uint32_t>(sand[y * w + x], 4);
+					changed |= row[x] ^ index;
+					row[x] = index;
+				}
+				changedRows[y] = changed != 0;
+			});
+			for(int32_t y = 0; y < h; ++y) {
+				if(changedRows[y]) {fb.markDirty(0, y, w, 1);}
 			}
 		}
-		unlockTexture(frame);
+		unlockIndexed(frame, fb);
 	}
 
 	void setSand(uint32_t* sand, uint32_t val) {
-		#pragma omp parallel for schedule(dynamic)
-		for(size_t i = 0; i < w*h; ++i) {
-			sand[i] = val;
-		}
+		std::fill(sand, sand + w*h, val);
 	}
 };
 
@@ -3,7 +3,26 @@
 
 #include <vector>
 #include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <bitset>
+#include <cstdio>
+#include <string>
 #include <SDL2/SDL.h>
+#if !defined(ARGON_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#define ARGON_SIMD_X86
+	#include <immintrin.h>
+#endif
 #ifdef ARGON_INCLUDE_GFX
 	#include <SDL2/SDL2_gfxPrimitives.h>
 #endif
@@ -23,6 +42,52 @@
 #define ARGON_NO_TASKBAR 256
 #define ARGON_MOUSE_CAPTURE 512
 #define ARGON_VSYNC 1024
+#define ARGON_HEADLESS 2048
+
+// Number of frames the profiler keeps history for
+#ifndef ARGON_PROFILE_FRAMES
+	#define ARGON_PROFILE_FRAMES 240
+#endif
+
+// Number of distinct colors in a batch after which it is drawn with a single SDL_RenderGeometry call instead of one call per color
+#ifndef ARGON_BATCH_GEOMETRY_COLORS
+	#define ARGON_BATCH_GEOMETRY_COLORS 16
+#endif
+
+// Width and height in pixels of the tiles forEachPixel/forEachTile split textures into (64x64 RGBA is 16KB)
+#ifndef ARGON_TILE_SIZE
+	#define ARGON_TILE_SIZE 64
+#endif
+
+// Milliseconds the window size has to stay unchanged before textures are recreated and onWindowResize runs
+#ifndef ARGON_RESIZE_DEBOUNCE
+	#define ARGON_RESIZE_DEBOUNCE 100
+#endif
+
+// Width and height in pixels of the textures glyphs are packed into (grows for fonts that don't fit)
+#ifndef ARGON_GLYPH_PAGE_SIZE
+	#define ARGON_GLYPH_PAGE_SIZE 512
+#endif
+
+// Width and height in pixels of the textures sprites are packed into (larger images get a texture of their own)
+#ifndef ARGON_SPRITE_PAGE_SIZE
+	#define ARGON_SPRITE_PAGE_SIZE 2048
+#endif
+
+// Diameter in pixels of the largest pre-rasterized circle used by circles(), smaller ones halve down to 4 pixels
+#ifndef ARGON_CIRCLE_SPRITE_SIZE
+	#define ARGON_CIRCLE_SPRITE_SIZE 256
+#endif
+
+// Number of freed textures kept around (bucketed by size) to be reused instead of allocating new ones
+#ifndef ARGON_TEXTURE_POOL_SIZE
+	#define ARGON_TEXTURE_POOL_SIZE 4
+#endif
+
+// Number of frame buffers shared by the main thread and the capture encoder, also the most frames that can be waiting to be encoded
+#ifndef ARGON_CAPTURE_BUFFERS
+	#define ARGON_CAPTURE_BUFFERS 4
+#endif
 
 
 // Event Structs
@@ -80,9 +145,168 @@ struct WheelEvent : Event {
 struct FileDropEvent : Event {
 	char* path;
 };
+struct FrameEvent : Event {
+	uint64_t frame;
+	int32_t w;
+	int32_t h;
+	int32_t pitch;
+	const uint8_t* pixels;
+};
+
+// Keyboard and mouse state polled once per frame, see getInput
+struct InputState {
+	std::bitset<SDL_NUM_SCANCODES> keys; // Held keys by scancode
+	std::bitset<SDL_NUM_SCANCODES> pressed; // Went down since the last frame (key repeats don't count)
+	std::bitset<SDL_NUM_SCANCODES> released; // Went up since the last frame
+	uint32_t buttons; // Held mouse buttons, SDL_BUTTON(SDL_BUTTON_LEFT) | ...
+	uint32_t buttonsPressed;
+	uint32_t buttonsReleased;
+	int32_t x;
+	int32_t y;
+	int32_t rx; // Mouse movement since the last frame
+	int32_t ry;
+	int32_t wheelX; // Wheel movement since the last frame, flipped wheels are already turned around
+	int32_t wheelY;
+
+	bool key(SDL_Scancode code) const {return keys[code];}
+	bool keyPressed(SDL_Scancode code) const {return pressed[code];}
+	bool keyReleased(SDL_Scancode code) const {return released[code];}
+	bool button(uint8_t which) const {return buttons & SDL_BUTTON(which);}
+	bool buttonPressed(uint8_t which) const {return buttonsPressed & SDL_BUTTON(which);}
+	bool buttonReleased(uint8_t which) const {return buttonsReleased & SDL_BUTTON(which);}
+};
 
 typedef SDL_Texture* Texture;
 
+// View of a texture's pixels that respects the row pitch and tracks which region was modified
+template<uint8_t BytesPerPixel> struct PixelBuffer {
+	uint8_t* pixels;
+	int32_t w;
+	int32_t h;
+	int32_t pitch;
+	SDL_Rect dirty;
+	uint32_t format = SDL_PIXELFORMAT_RGBA32; // Channel order of 4 byte pixels, SDL_PIXELFORMAT_RGBA32 or SDL_PIXELFORMAT_BGRA32
+
+	inline uint8_t* row(int32_t y) {return pixels + y * pitch;}
+	inline uint8_t* at(int32_t x, int32_t y) {return pixels + y * pitch + x * BytesPerPixel;}
+	inline uint32_t value(uint32_t color) const {
+		// 0xRRGGBBAA to the 32 bit pixel in this buffer's channel order, the alpha is the last byte in both
+		const bool bgra = format == SDL_PIXELFORMAT_BGRA32;
+		const uint8_t bytes[4] = {(uint8_t)(color >> (bgra ? 8 : 24)), (uint8_t)(color >> 16), (uint8_t)(color >> (bgra ? 24 : 8)), (uint8_t)color};
+		uint32_t v;
+		memcpy(&v, bytes, 4);
+		return v;
+	}
+	inline uint32_t color(const uint8_t* pixel) const {
+		const bool bgra = format == SDL_PIXELFORMAT_BGRA32;
+		return (uint32_t)pixel[bgra ? 2 : 0] << 24 | (uint32_t)pixel[1] << 16 | (uint32_t)pixel[bgra ? 0 : 2] << 8 | pixel[3];
+	}
+	inline void set(int32_t x, int32_t y, uint32_t color) {
+		const uint32_t v = value(color);
+		memcpy(at(x, y), &v, 4);
+	}
+	inline uint32_t get(int32_t x, int32_t y) {return color(at(x, y));}
+	inline bool isDirty() {return dirty.w > 0 && dirty.h > 0;}
+	void markDirty(int32_t x, int32_t y, int32_t rw, int32_t rh) {
+		// Clip to the buffer and grow the dirty region to contain the rectangle
+		if(x < 0) {rw += x; x = 0;}
+		if(y < 0) {rh += y; y = 0;}
+		if(x + rw > w) {rw = w - x;}
+		if(y + rh > h) {rh = h - y;}
+		if(rw <= 0 || rh <= 0) {return;}
+		if(!isDirty()) {dirty = {x, y, rw, rh}; return;}
+		int32_t x2 = std::max(dirty.x + dirty.w, x + rw), y2 = std::max(dirty.y + dirty.h, y + rh);
+		dirty.x = std::min(dirty.x, x);
+		dirty.y = std::min(dirty.y, y);
+		dirty.w = x2 - dirty.x;
+		dirty.h = y2 - dirty.y;
+	}
+	void markAllDirty() {dirty = {0, 0, w, h};}
+};
+typedef PixelBuffer<4> Framebuffer; // RGBA or BGRA pixels, see format
+typedef PixelBuffer<1> IndexedFramebuffer; // Palette indices, see lockIndexed
+
+// Per frame counters for Argon's drawing api
+struct DrawStats {
+	uint32_t commands;
+	uint32_t stateChangesAvoided;
+	uint32_t sdlCalls;
+};
+
+// Frame pacing statistics for the frame limiter (times in milliseconds)
+struct PacingStats {
+	uint32_t frames;
+	uint32_t missed;
+	double targetMs;
+	double avgErrorMs;
+	double maxErrorMs;
+	double jitterMs;
+	double avgSleepMs;
+	double avgSpinMs;
+};
+
+// Rolling statistics of a profiler phase over the last ARGON_PROFILE_FRAMES frames (times in milliseconds)
+struct ProfileStats {
+	double minMs;
+	double avgMs;
+	double p99Ms;
+	double maxMs;
+};
+
+// Frame capture counters, frames that were read back and frames that were skipped because the encoder was behind
+struct CaptureStats {
+	uint64_t frames;
+	uint64_t dropped;
+};
+
+// Pixel kernel implementations, the fastest one the CPU supports is picked at runtime
+enum SimdLevel : uint8_t {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2};
+
+// How a texture follows the window size, POW2 textures only reallocate when the window outgrows them (or shrinks below half)
+enum TextureResize : uint8_t {TEXTURE_FOLLOW_WINDOW, TEXTURE_FIXED, TEXTURE_POW2};
+
+// Channel order of a texture's pixels, TEXTURE_NATIVE is whichever of the two the renderer uploads without converting
+enum TextureFormat : uint8_t {TEXTURE_RGBA, TEXTURE_BGRA, TEXTURE_NATIVE};
+
+// Identifies a texture without pointing at it, slot index in the low 32 bits and generation in the high 32 bits (0 is never valid)
+typedef uint64_t TextureHandle;
+
+// Frame capture file formats and what happens to a frame when every capture buffer is still waiting to be encoded
+enum CaptureFormat : uint8_t {CAPTURE_GIF, CAPTURE_Y4M, CAPTURE_RAW};
+enum CapturePolicy : uint8_t {CAPTURE_DROP, CAPTURE_WAIT};
+
+// Image packed into a sprite atlas, 0 is never a valid sprite
+typedef uint32_t Sprite;
+
+// Circle drawn by circles(), centered on x, y
+struct Circle {
+	float x;
+	float y;
+	float radius;
+	uint32_t color;
+};
+
+// Render target layer, see createLayer (w & h are in pixels, the renderer's output size)
+struct Layer {
+	SDL_Texture* texture;
+	int32_t w;
+	int32_t h;
+	int16_t order;
+	bool visible;
+	bool dirty;
+};
+
+// Job System
+struct JobState {
+	std::function<void()> task;
+	std::atomic<uint32_t> waitingFor{1}; // Unfinished dependencies, +1 until the job is submitted
+	std::atomic<bool> done{false};
+	std::atomic<uint32_t>* group = NULL; // Decremented when done (parallelFor chunks)
+	std::mutex mutex;
+	std::vector<std::shared_ptr<JobState>> next; // Jobs that depend on this one
+};
+typedef std::shared_ptr<JobState> Job; // An empty Job counts as finished
+
 // Additional GFX Helper functions
 #ifdef ARGON_INCLUDE_TTF 
 	typedef TTF_Font Font;
@@ -92,6 +316,10 @@ typedef SDL_Texture* Texture;
 class Argon {
 public:
 	Argon(const char* title, int32_t x, int32_t y, int32_t w, int32_t h, uint16_t flags=ARGON_VSYNC|ARGON_RESIZABLE|ARGON_HIGHDPI) : title(title), _wx(x), _wy(y), _ww(w), _wh(h), flags(flags) {
+		// Allow any Argon app to be run offscreen, e.g. `ARGON_HEADLESS=1 ARGON_FRAMES=600 ./app`
+		if(envFlag("ARGON_HEADLESS")) {this->flags |= ARGON_HEADLESS;}
+		if(getenv("ARGON_FRAMES") != NULL) {maxFrames = strtoull(getenv("ARGON_FRAMES"), NULL, 10);}
+		if(this->flags & ARGON_HEADLESS) {SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");}
 		if(SDL_Init(SDL_INIT_VIDEO) < 0) {
 			fprintf(stderr, "Failed to initialize SDL\n");
 			return;
@@ -106,9 +334,22 @@ public:
 	Argon(const char* title) : Argon(title, SDL_WINDOWPOS_UNDEFINED,SDL_WINDOWPOS_UNDEFINED,500,500) {};
 	Argon() : Argon("Argon", SDL_WINDOWPOS_UNDEFINED,SDL_WINDOWPOS_UNDEFINED,500,500) {};
 	~Argon() {
+		stopRecording();
+		stopCapture();
+		setAsyncFramebuffer(NULL);
+		stopJobWorkers();
 		destroyAllTextures();
+		for(auto& layer : layers) {
+			if(layer->texture != NULL) {SDL_DestroyTexture(layer->texture);}
+		}
+		freeSprites();
+		for(Atlas& sheet : circleSheets) {atlasFree(sheet);}
+		#ifdef ARGON_INCLUDE_TTF
+			while(!glyphAtlases.empty()) {freeGlyphAtlas(glyphAtlases.begin()->first);}
+		#endif
 		SDL_DestroyRenderer(renderer);
-		SDL_DestroyWindow(window);
+		if(window != NULL) {SDL_DestroyWindow(window);}
+		if(surface != NULL) {SDL_FreeSurface(surface);}
 		#ifdef ARGON_DYNAMIC_RESIZE
 			SDL_DelEventWatch(handleResize, this);
 		#endif
@@ -132,21 +373,31 @@ public:
 		if(flags & ARGON_MOUSE_CAPTURE) {wf |= SDL_WINDOW_MOUSE_CAPTURE;}
 		if(flags & ARGON_VSYNC) {vsyncEnabled=true;rf |= SDL_RENDERER_PRESENTVSYNC;}
 
-		window = SDL_CreateWindow(title, _wx, _wy, _ww, _wh, wf);
-		renderer = SDL_CreateRenderer(window, -1, rf);
-		SDL_SetWindowTitle(window, title);
+		int ww = _ww, wh = _wh, mx = 0, my = 0, wx = 0, wy = 0;
+		if(flags & ARGON_HEADLESS) {
+			// No window, render in software to an offscreen surface
+			vsyncEnabled = false;
+			surface = SDL_CreateRGBSurfaceWithFormat(0, _ww, _wh, 32, SDL_PIXELFORMAT_RGBA32);
+			renderer = SDL_CreateSoftwareRenderer(surface);
+		}
+		else {
+			window = SDL_CreateWindow(title, _wx, _wy, _ww, _wh, wf);
+			renderer = SDL_CreateRenderer(window, -1, rf);
+			SDL_SetWindowTitle(window, title);
+			SDL_GetWindowSize(window, &ww, &wh);
+			SDL_GetMouseState(&mx, &my);
+			SDL_GetWindowPosition(window, &wx, &wy);
+		}
 		SDL_RenderSetIntegerScale(renderer, SDL_TRUE);
 		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2");
-		int ww, wh, mx, my, wx, wy;
-		SDL_GetWindowSize(window, &ww, &wh);
-		SDL_GetMouseState(&mx, &my);
-		SDL_GetWindowPosition(window, &wx, &wy);
 		_ww = (uint16_t)ww;
 		_wh = (uint16_t)wh;
 		_wx = (uint16_t)wx;
 		_wy = (uint16_t)wy;
 		_mx = (uint16_t)mx;
 		_my = (uint16_t)my;
+		input.x = _mx;
+		input.y = _my;
 
 		SDL_EventState(SDL_DROPFILE, SDL_ENABLE);
 		#ifdef ARGON_DYNAMIC_RESIZE
@@ -159,29 +410,95 @@ public:
 		SDL_Event event;
 		while(SDL_PollEvent(&event)) {}
 		onLoad({{SDL_GetTicks()}, _wx, _wy, _ww, _wh});
+		if(getenv("ARGON_RECORD") != NULL) {startRecording(getenv("ARGON_RECORD"));}
+		if(getenv("ARGON_REPLAY") != NULL) {startReplay(getenv("ARGON_REPLAY"), !envFlag("ARGON_REPLAY_FAST"));}
+		if(getenv("ARGON_CAPTURE") != NULL) {
+			// The format follows the extension, headless runs wait for the encoder since there is no frame rate to protect
+			const char* file = getenv("ARGON_CAPTURE");
+			const char* ext = strrchr(file, '.');
+			CaptureFormat format = ext == NULL ? CAPTURE_RAW : SDL_strcasecmp(ext, ".gif") == 0 ? CAPTURE_GIF : SDL_strcasecmp(ext, ".y4m") == 0 ? CAPTURE_Y4M : CAPTURE_RAW;
+			startCapture(file, format, surface != NULL ? CAPTURE_WAIT : CAPTURE_DROP);
+		}
 
 		// Setup & run game loop
+		wakeEvent = SDL_RegisterEvents(1);
 		uint64_t now = 0, prev = SDL_GetPerformanceCounter();
 		while(running) {
 			// Event Handling
+			if(onDemand && !replaying) {
+				// Block until something asks for a redraw, time spent idle is not part of the next deltaTime
+				if(!waitForRedraw(event)) {continue;}
+				prev = SDL_GetPerformanceCounter();
+			}
+
+			// Upload pixels if a background fill finished since the last frame, a fill still running keeps the last texture
+			if(asyncPixels.texture != NULL) {syncPixels(true);}
+			uint64_t frameStart = profileNow();
+			uint64_t phaseStart = frameStart;
 			while(SDL_PollEvent(&event)) {
-				handleEvent(event);
+				// While replaying live input is ignored, only closing the window and renderer resets still work
+				if(!replaying || event.type == SDL_QUIT || event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {handleEvent(event);}
+			}
+			if(replaying && !replayEvents()) {
+				stopReplay();
+				stop();
 			}
+			if(motionPending) {flushMotion();}
+			if(resizePending) {
+				int32_t left = (int32_t)(resizeAt - SDL_GetTicks());
+				if(left <= 0) {applyResize();}
+				else if(onDemand) {requestRedrawIn(left);}
+			}
+			phaseStart = profileEnd(PHASE_EVENTS, phaseStart);
 			if(!running) {break;} //If quit occurs
 
 			// Call Game Loop
 			now = SDL_GetPerformanceCounter();
-			if(prev < now) {
-				gameLoop((now - prev)/(double)SDL_GetPerformanceFrequency());
+			if(prev < now || replaying) {
+				double dt = replaying ? replayDt : (now - prev)/(double)SDL_GetPerformanceFrequency();
+				if(recordFile != NULL) {recordFrame(dt);}
+				gameLoop(dt);
+				if(fixedStep > 0) {runFixedSteps(dt);}
 				prev = now;
+				resetInputEdges();
+			}
+			if(renderTarget != NULL) {endTarget();}
+			phaseStart = profileEnd(PHASE_GAME_LOOP, phaseStart);
+			if(asyncPixels.requested) {startPixels();}
+			if(!layers.empty()) {compositeLayers(INT16_MAX);}
+			if(profilerOverlay) {
+				drawProfilerOverlay();
+				phaseStart = profileNow();
 			}
 
 			//Render
-			SDL_RenderSetLogicalSize(renderer, _ww, _wh);
+			flushCommands();
+			phaseStart = profileEnd(PHASE_FLUSH, phaseStart);
+			if(!vsyncEnabled && targetFps > 0) {limitFrameRate();}
+			phaseStart = profileEnd(PHASE_WAIT, phaseStart);
+			if(logicalW != _ww || logicalH != _wh) {
+				SDL_RenderSetLogicalSize(renderer, _ww, _wh);
+				logicalW = _ww;
+				logicalH = _wh;
+			}
+			if(capture.file != NULL) {
+				captureFrame();
+				phaseStart = profileEnd(PHASE_CAPTURE, phaseStart);
+			}
 			SDL_RenderPresent(renderer);
+			profileEnd(PHASE_PRESENT, phaseStart);
+			profileEnd(PHASE_FRAME, frameStart);
+			if(profiling) {commitProfileFrame();}
+			if(surface != NULL) {onFrame({{SDL_GetTicks()}, frames, surface->w, surface->h, surface->pitch, (const uint8_t*)surface->pixels});}
+			lastDrawStats = frameStats;
+			frameStats = {0, 0, 0};
+			if(++frames == maxFrames && running) {stop();}
 			clear();
 		}
-
+		if(asyncPixels.texture != NULL) {syncPixels(false);}
+		if(jobs.started) {waitJobs();}
+		stopRecording();
+		stopCapture();
 	}
 
 	void stop() {onUnload({{SDL_GetTicks()}, _wx, _wy, _ww, _wh});running = false;}
@@ -211,10 +528,19 @@ public:
 	virtual void onWindowTakeFocus(const WindowEvent event) {}
 	virtual void onWindowHitTest(const WindowEvent event) {}
 	virtual void onFileDrop(const FileDropEvent event) {}
+	virtual void onFrame(const FrameEvent event) {}
 
 	// Main Game Loop
 	virtual void gameLoop(double deltaTime) {}
 
+	// Fixed Timestep Loop (only called once setFixedTimestep is used)
+	virtual void simulate(double step) {}
+	virtual void render(double alpha) {}
+
+	// Async Framebuffer (fillPixels is called on a background thread once setAsyncFramebuffer is used, preparePixels on the main thread right before)
+	virtual void preparePixels() {}
+	virtual void fillPixels(Framebuffer& fb) {}
+
 	// Translating SDL Functions
 	void maximize() {SDL_MaximizeWindow(window);}
 	void minimize() {SDL_MinimizeWindow(window);}
@@ -242,6 +568,35 @@ public:
 
 	// Get Variables
 	bool isRunning() {return running;}
+	bool isHeadless() {return flags & ARGON_HEADLESS;}
+	double fixedTimestep() {return fixedStep;}
+	double getTargetFPS() {return targetFps;}
+	bool isProfiling() {return profiling;}
+	bool isShowingProfiler() {return profilerOverlay;}
+	bool isOnDemand() {return onDemand;}
+	bool isCoalescingMotion() {return coalesceMotion;}
+	bool isRecording() {return recordFile != NULL;}
+	bool isReplaying() {return replaying;}
+	bool isCapturing() {return capture.file != NULL;}
+	CaptureStats getCaptureStats() {return capture.stats;}
+	const InputState& getInput() {return input;}
+	bool isMinimized() {return minimized;}
+	PacingStats getPacingStats() {
+		const double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+		PacingStats stats = {pacing.frames, pacing.missed, targetFps > 0 ? 1000.0 / targetFps : 0, 0, pacing.maxError * toMs, 0, 0, 0};
+		if(pacing.frames > 0) {
+			stats.avgErrorMs = pacing.error * toMs / pacing.frames;
+			stats.avgSleepMs = pacing.sleep * toMs / pacing.frames;
+			stats.avgSpinMs = pacing.spin * toMs / pacing.frames;
+		}
+		if(pacing.intervals > 1) {
+			double mean = pacing.interval / pacing.intervals;
+			double variance = pacing.interval2 / pacing.intervals - mean * mean;
+			stats.jitterMs = sqrt(variance > 0 ? variance : 0) * toMs;
+		}
+		return stats;
+	}
+	uint64_t frameCount() {return frames;}
 	int32_t wx() {return _wx;}
 	int32_t wy() {return _wy;}
 	int32_t ww() {return _ww;}
@@ -260,220 +615,1163 @@ public:
 
 	//Setters
 	void setAntiAlias(bool val) {antiAlias = val;}
+	void setCoalesceMotion(bool val) {
+		// Merge all mouse motion between two other events into one onMouseMove call
+		coalesceMotion = val;
+		if(!val && motionPending) {flushMotion();}
+	}
+	void setMaxFrames(uint64_t count) {maxFrames = count;}
+	void setOnDemand(bool val) {
+		onDemand = val;
+		requestRedraw();
+	}
+	void requestRedraw() {
+		redrawRequested = true;
+		wakeGameLoop();
+	}
+	void requestRedrawIn(uint32_t ms) {
+		// Keep the earliest deadline when several threads schedule redraws at once
+		uint32_t at = SDL_GetTicks() + ms;
+		uint32_t current = redrawAt;
+		while((current == 0 || at < current) && !redrawAt.compare_exchange_weak(current, at)) {}
+		wakeGameLoop();
+	}
+	void setTargetFPS(double fps) {
+		targetFps = fps > 0 ? fps : 0;
+		nextFrameDeadline = 0;
+	}
+	void resetPacingStats() {pacing = {};}
+	void setFixedTimestep(double stepsPerSecond, uint16_t maxStepsPerFrame = 8) {
+		fixedStep = stepsPerSecond > 0 ? 1.0 / stepsPerSecond : 0;
+		maxSteps = maxStepsPerFrame > 0 ? maxStepsPerFrame : 1;
+		if(fixedStep == 0) {stepAccumulator = 0;}
+	}
 	void setBackground(uint32_t c) {background = {(uint8_t)(c>>24), (uint8_t)(c>>16), (uint8_t)(c>>8), (uint8_t)c};}
 	void setBackground(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {background = {r, g, b, a};}
 
 	// Rendering to texture
-	Texture* createTexture() {
-		if(textures.size() >= 255) {return NULL;}
-		textures.emplace_back(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, _ww, _wh));
-		return &textures.back();
+	Texture* createTexture(TextureResize resize = TEXTURE_FOLLOW_WINDOW, bool preserve = false) {
+		return createTexture(_ww, _wh, resize, preserve);
 	}
-	bool destroyTexture(Texture* texture) {
-		for(uint8_t i = 0; i < textures.size(); ++i) {
-			if(textures[i] == *texture) {
-				if(*texture != NULL) {SDL_DestroyTexture(*texture);}
-				textures.erase(textures.begin() + i);
-				return true;
+	Texture* createTexture(int32_t w, int32_t h, TextureResize resize = TEXTURE_FIXED, bool preserve = false) {
+		return createTexture(w, h, TEXTURE_RGBA, SDL_TEXTUREACCESS_STREAMING, resize, preserve);
+	}
+	Texture* createTexture(TextureFormat format, SDL_TextureAccess access = SDL_TEXTUREACCESS_STREAMING, TextureResize resize = TEXTURE_FOLLOW_WINDOW, bool preserve = false) {
+		return createTexture(_ww, _wh, format, access, resize, preserve);
+	}
+	Texture* createTexture(int32_t w, int32_t h, TextureFormat format, SDL_TextureAccess access = SDL_TEXTUREACCESS_STREAMING, TextureResize resize = TEXTURE_FIXED, bool preserve = false) {
+		// Preserved textures keep their contents (the overlapping part) when recreated for a new window size
+		const uint32_t pixelFormat = sdlFormat(format);
+		SDL_Texture* texture = NULL;
+		if(resize == TEXTURE_POW2) {texture = allocTexture(nextPow2(w), nextPow2(h), pixelFormat, access);}
+		if(texture == NULL) {texture = allocTexture(w, h, pixelFormat, access);}
+
+		// Reuse a free slot, the returned pointer stays valid until the texture is destroyed
+		uint32_t index;
+		if(freeTextureSlots.empty()) {
+			index = textureSlots.size();
+			textureSlots.push_back({NULL, 1, index, false});
+		}
+		else {
+			index = freeTextureSlots.back();
+			freeTextureSlots.pop_back();
+		}
+		TextureSlot& slot = textureSlots[index];
+		slot.texture = texture;
+		slot.live = true;
+		if(texture != NULL) {textureInfo[texture] = {resize, preserve, w, h, false, index, pixelFormat, access};}
+		return &slot.texture;
+	}
+	uint32_t getTextureFormat(Texture* texture) {return textureFormat(*texture);}
+	uint32_t getNativeFormat() {
+		// The first 32 bit RGBA or BGRA format in the renderer's list, the list starts with the formats it prefers
+		if(nativeFormat == SDL_PIXELFORMAT_UNKNOWN) {
+			SDL_RendererInfo info;
+			nativeFormat = SDL_PIXELFORMAT_RGBA32;
+			if(SDL_GetRendererInfo(renderer, &info) == 0) {
+				for(uint32_t i = 0; i < info.num_texture_formats; ++i) {
+					if(info.texture_formats[i] == SDL_PIXELFORMAT_RGBA32 || info.texture_formats[i] == SDL_PIXELFORMAT_BGRA32) {
+						nativeFormat = info.texture_formats[i];
+						break;
+					}
+				}
 			}
 		}
-		return false;
+		return nativeFormat;
+	}
+	bool destroyTexture(Texture* texture) {
+		TextureSlot* slot = findTextureSlot(texture);
+		if(slot == NULL) {return false;}
+		if(asyncPixels.texture == &slot->texture) {setAsyncFramebuffer(NULL);}
+		if(slot->texture != NULL) {
+			if(renderTarget == slot->texture) {endTarget();}
+			shadowBuffers.erase(slot->texture);
+			indexedTextures.erase(slot->texture);
+			textureInfo.erase(slot->texture);
+			releaseTexture(slot->texture);
+		}
+		freeTextureSlot(*slot);
+		return true;
+	}
+	TextureHandle getTextureHandle(Texture* texture) {
+		TextureSlot* slot = findTextureSlot(texture);
+		if(slot == NULL) {return 0;}
+		return ((uint64_t)slot->generation << 32) | slot->index;
+	}
+	Texture* getTexture(TextureHandle handle) {
+		// NULL once the texture was destroyed, even if its slot has been reused since
+		uint32_t index = (uint32_t)handle, generation = handle >> 32;
+		if(index >= textureSlots.size()) {return NULL;}
+		TextureSlot& slot = textureSlots[index];
+		return slot.live && slot.generation == generation ? &slot.texture : NULL;
 	}
 	void destroyAllTextures() {
-		for(auto texture : textures) {
-			if(texture != NULL) {SDL_DestroyTexture(texture);}
+		setAsyncFramebuffer(NULL);
+		for(auto& slot : textureSlots) {
+			if(!slot.live) {continue;}
+			if(slot.texture != NULL) {SDL_DestroyTexture(slot.texture);}
+			freeTextureSlot(slot);
 		}
-		textures.clear();
+		for(auto& pooled : texturePool) {SDL_DestroyTexture(pooled.second);}
+		texturePool.clear();
+		shadowBuffers.clear();
+		indexedTextures.clear();
+		textureInfo.clear();
 	}
 	uint8_t* lockTexture(Texture* texture, int32_t* w, int32_t* h) {
+		int32_t pitch;
+		return lockTexture(texture, w, h, &pitch);
+	}
+	uint8_t* lockTexture(Texture* texture, int32_t* w, int32_t* h, int32_t* pitch) {
 		uint8_t* pixels = NULL;
-		if(*texture != NULL) {
-			int res = SDL_QueryTexture(*texture, NULL, NULL, w, h);
-			if(res == 0) {
-				int pitch;
-				if(SDL_LockTexture(*texture, NULL, reinterpret_cast<void**>(&pixels), &pitch) != 0) {
+		uint64_t start = profileNow();
+		if(textureSize(*texture, w, h)) {
+			auto info = textureInfo.find(*texture);
+			if(info != textureInfo.end() && info->second.preserve) {
+				// Preserved textures are written in their CPU copy and uploaded on unlock, locked texture memory is write only
+				std::vector<uint8_t>& shadow = shadowBuffers[*texture];
+				if(shadow.size() != (size_t)*w * 4 * *h) {shadow.assign((size_t)*w * 4 * *h, 0);}
+				pixels = shadow.data();
+				*pitch = *w * 4;
+				info->second.locked = true;
+			}
+			else {
+				// POW2 textures can be larger than their visible size, only that part is locked
+				SDL_Rect rect = {0, 0, *w, *h};
+				if(SDL_LockTexture(*texture, &rect, reinterpret_cast<void**>(&pixels), pitch) != 0) {
 					pixels = NULL;
 				}
 			}
 		}
+		profileEnd(PHASE_TEXTURE, start);
 		return pixels;
 	}
+	Framebuffer lockFramebuffer(Texture* texture) {
+		// Pixels live in a CPU copy of the texture that keeps its contents between frames
+		Framebuffer fb = {NULL, 0, 0, 0, {0, 0, 0, 0}};
+		if(!textureSize(*texture, &fb.w, &fb.h)) {return fb;}
+		fb.pitch = fb.w * 4;
+		fb.format = textureFormat(*texture);
+		std::vector<uint8_t>& shadow = shadowBuffers[*texture];
+		if(shadow.size() != (size_t)fb.pitch * fb.h) {
+			shadow.assign((size_t)fb.pitch * fb.h, 0);
+			fb.markAllDirty();
+		}
+		fb.pixels = shadow.data();
+		return fb;
+	}
+	void unlockFramebuffer(Texture* texture, Framebuffer& fb) {
+		// Only upload the region that changed
+		if(fb.pixels != NULL && fb.isDirty() && *texture != NULL) {
+			uint64_t start = profileNow();
+			SDL_UpdateTexture(*texture, &fb.dirty, fb.at(fb.dirty.x, fb.dirty.y), fb.pitch);
+			profileEnd(PHASE_TEXTURE, start);
+		}
+		fb.dirty = {0, 0, 0, 0};
+	}
+	IndexedFramebuffer lockIndexed(Texture* texture) {
+		// 1 byte palette index per pixel, expanded to RGBA when unlocked
+		IndexedFramebuffer fb = {NULL, 0, 0, 0, {0, 0, 0, 0}};
+		if(!textureSize(*texture, &fb.w, &fb.h)) {return fb;}
+		fb.pitch = fb.w;
+		IndexedTexture& indexed = indexedTexture(*texture);
+		if(indexed.indices.size() != (size_t)fb.w * fb.h) {
+			indexed.indices.assign((size_t)fb.w * fb.h, 0);
+			fb.markAllDirty();
+		}
+		fb.pixels = indexed.indices.data();
+		return fb;
+	}
+	void unlockIndexed(Texture* texture, IndexedFramebuffer& fb) {
+		// Only the dirty region is expanded and uploaded
+		auto indexed = indexedTextures.find(*texture);
+		if(fb.pixels != NULL && fb.isDirty() && indexed != indexedTextures.end()) {uploadIndexed(*texture, indexed->second, fb.w, fb.dirty);}
+		fb.dirty = {0, 0, 0, 0};
+	}
+	void setPalette(Texture* texture, const uint32_t* colors, uint16_t count = 256, uint8_t first = 0) {
+		// Recolors the whole texture right away without touching the indices
+		if(*texture == NULL) {return;}
+		IndexedTexture& indexed = indexedTexture(*texture);
+		const uint32_t format = textureFormat(*texture);
+		for(uint16_t i = 0; i < count && first + i < 256; ++i) {indexed.palette[first + i] = pixelValue(colors[i], format);}
+		int32_t w, h;
+		if(!indexed.indices.empty() && textureSize(*texture, &w, &h) && indexed.indices.size() == (size_t)w * h) {
+			uploadIndexed(*texture, indexed, w, {0, 0, w, h});
+		}
+	}
+	void setPaletteColor(Texture* texture, uint8_t index, uint32_t color) {setPalette(texture, &color, 1, index);}
 	void getTextureSize(Texture* texture, int32_t* w, int32_t* h) {
-		SDL_QueryTexture(*texture, NULL, NULL, w, h);
+		textureSize(*texture, w, h);
 	}
 	void unlockTexture(Texture* texture) {
-		SDL_UnlockTexture(*texture);
+		uint64_t start = profileNow();
+		auto info = textureInfo.find(*texture);
+		if(info != textureInfo.end() && info->second.locked) {
+			// The CPU copy is the source of truth, so the contents survive the texture being recreated
+			TextureInfo& ti = info->second;
+			std::vector<uint8_t>& shadow = shadowBuffers[*texture];
+			SDL_Rect rect = {0, 0, ti.w, ti.h};
+			if(shadow.size() == (size_t)ti.w * 4 * ti.h) {SDL_UpdateTexture(*texture, &rect, shadow.data(), ti.w * 4);}
+			ti.locked = false;
+		}
+		else {SDL_UnlockTexture(*texture);}
+		profileEnd(PHASE_TEXTURE, start);
+	}
+	void setResizeDebounce(uint32_t ms) {resizeDebounce = ms;}
+	void setAsyncFramebuffer(Texture* texture) {
+		// Start (or stop with NULL) filling the texture with fillPixels() on a background thread
+		if(asyncPixels.thread.joinable()) {
+			syncPixels(false);
+			{
+				std::lock_guard<std::mutex> lock(asyncPixels.mutex);
+				asyncPixels.quit = true;
+			}
+			asyncPixels.cv.notify_all();
+			asyncPixels.thread.join();
+		}
+		asyncPixels.texture = texture;
+		asyncPixels.requested = false;
+		asyncPixels.quit = false;
+		for(std::vector<uint8_t>& buffer : asyncPixels.buffers) {std::vector<uint8_t>().swap(buffer);}
+		asyncPixels.frontDirty = {0, 0, 0, 0};
+		if(texture != NULL) {asyncPixels.thread = std::thread(&Argon::pixelWorker, this);}
+	}
+	void requestPixels() {
+		// fillPixels() starts after this frame's gameLoop (or a later one while the last fill is still running) and is shown once it finished
+		if(asyncPixels.texture != NULL) {asyncPixels.requested = true;}
+	}
+
+	// Job System
+	Job addJob(std::function<void()> task) {return submitJob(std::move(task), NULL, NULL, 0);}
+	Job addJob(std::function<void()> task, const Job& after) {return submitJob(std::move(task), NULL, &after, 1);}
+	Job addJob(std::function<void()> task, std::initializer_list<Job> after) {return submitJob(std::move(task), NULL, after.begin(), after.size());}
+	bool isJobDone(const Job& job) {return !job || job->done;}
+	void waitJob(const Job& job) {
+		if(job) {helpUntil([&] {return job->done.load();});}
+	}
+	void waitJobs() {
+		// Wait for every job submitted so far, e.g. once per frame before using their results
+		helpUntil([this] {return jobs.unfinished == 0;});
+	}
+	uint32_t workerCount() {
+		if(!jobs.started) {startJobWorkers();}
+		return jobs.queues.size() - 1;
+	}
+	template<typename Fn> void parallelFor(int32_t begin, int32_t end, Fn fn, uint32_t grain = 0) {
+		// Call fn(i) for every i in [begin, end) across all cores, grain is the number of indices per job (0 picks one)
+		if(end <= begin) {return;}
+		if(!jobs.started) {startJobWorkers();}
+		const uint32_t count = end - begin;
+		uint32_t chunks = grain > 0 ? (count + grain - 1) / grain : std::min<uint32_t>(count, jobs.cores * 4);
+		if(chunks <= 1 || jobs.cores <= 1) {
+			for(int32_t i = begin; i < end; ++i) {fn(i);}
+			return;
+		}
+		std::atomic<uint32_t> remaining{chunks};
+		for(uint32_t c = 0; c < chunks; ++c) {
+			int32_t lo = begin + (uint64_t)count * c / chunks, hi = begin + (uint64_t)count * (c + 1) / chunks;
+			submitJob([&fn, lo, hi] {for(int32_t i = lo; i < hi; ++i) {fn(i);}}, &remaining, NULL, 0);
+		}
+		helpUntil([&] {return remaining == 0;});
+	}
+
+	// Parallel pixel kernels, the pixels are split into tiles that are spread across all cores
+	template<typename Kernel> void forEachTile(Framebuffer& fb, Kernel kernel) {
+		// kernel(x, y, tile) where x, y is the top left corner of the tile and tile.at(0, 0) is the pixel at x, y
+		if(fb.pixels == NULL) {return;}
+		const int32_t cols = (fb.w + ARGON_TILE_SIZE - 1) / ARGON_TILE_SIZE;
+		const int32_t rows = (fb.h + ARGON_TILE_SIZE - 1) / ARGON_TILE_SIZE;
+		auto runTile = [&](uint32_t i) {
+			int32_t x = (i % cols) * ARGON_TILE_SIZE, y = (i / cols) * ARGON_TILE_SIZE;
+			Framebuffer tile = {fb.at(x, y), std::min(ARGON_TILE_SIZE, fb.w - x), std::min(ARGON_TILE_SIZE, fb.h - y), fb.pitch, {0, 0, 0, 0}};
+			kernel(x, y, tile);
+		};
+		// Rows of neighbouring tiles per job, a few jobs per core instead of one per tile
+		parallelFor(0, cols * rows, runTile);
+	}
+	template<typename Kernel> void forEachPixel(Framebuffer& fb, Kernel kernel) {
+		// kernel(x, y, pixel) where pixel points to the 4 bytes (RGBA) of the pixel at x, y
+		forEachTile(fb, [&](int32_t x0, int32_t y0, Framebuffer& tile) {
+			for(int32_t y = 0; y < tile.h; ++y) {
+				uint8_t* pixel = tile.row(y);
+				for(int32_t x = 0; x < tile.w; ++x, pixel += 4) {kernel(x0 + x, y0 + y, pixel);}
+			}
+		});
+	}
+	template<typename Kernel> bool forEachTile(Texture* texture, Kernel kernel) {
+		Framebuffer fb = lockPixels(texture);
+		if(fb.pixels == NULL) {return false;}
+		forEachTile(fb, kernel);
+		unlockTexture(texture);
+		return true;
+	}
+	template<typename Kernel> bool forEachPixel(Texture* texture, Kernel kernel) {
+		Framebuffer fb = lockPixels(texture);
+		if(fb.pixels == NULL) {return false;}
+		forEachPixel(fb, kernel);
+		unlockTexture(texture);
+		return true;
+	}
+	// Pixel Kernels (colors are 0xRRGGBBAA like everywhere else, pixels are in the framebuffer's format)
+	static void pixelFill(Framebuffer& fb, uint32_t color) {pixelFillRect(fb, 0, 0, fb.w, fb.h, color);}
+	static void pixelFillRect(Framebuffer& fb, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+		if(!clipPixelRect(fb.w, fb.h, x, y, w, h) || fb.pixels == NULL) {return;}
+		const uint32_t value = fb.value(color);
+		for(int32_t row = y; row < y + h; ++row) {pixelKernels().fill(reinterpret_cast<uint32_t*>(fb.at(x, row)), value, w);}
+	}
+	static void pixelCopy(Framebuffer& dst, const Framebuffer& src, int32_t x = 0, int32_t y = 0) {
+		// Copy src into dst with its top left corner at x, y
+		int32_t sx = 0, sy = 0, w = src.w, h = src.h;
+		if(!clipPixelBlit(dst, x, y, sx, sy, w, h) || src.pixels == NULL) {return;}
+		for(int32_t row = 0; row < h; ++row) {
+			memmove(dst.at(x, y + row), src.pixels + (size_t)(sy + row) * src.pitch + sx * 4, (size_t)w * 4);
+		}
+	}
+	static void pixelBlend(Framebuffer& dst, const Framebuffer& src, int32_t x = 0, int32_t y = 0) {
+		// Draw src over dst with its top left corner at x, y using src alpha (same as SDL_BLENDMODE_BLEND)
+		int32_t sx = 0, sy = 0, w = src.w, h = src.h;
+		if(!clipPixelBlit(dst, x, y, sx, sy, w, h) || src.pixels == NULL) {return;}
+		for(int32_t row = 0; row < h; ++row) {
+			pixelKernels().blend(reinterpret_cast<uint32_t*>(dst.at(x, y + row)), reinterpret_cast<const uint32_t*>(src.pixels + (size_t)(sy + row) * src.pitch + sx * 4), w);
+		}
+	}
+	static void pixelRGBAtoARGB(Framebuffer& fb) {
+		// Reorder the bytes of every pixel from R, G, B, A to A, R, G, B (SDL_PIXELFORMAT_ARGB32)
+		for(int32_t row = 0; fb.pixels != NULL && row < fb.h; ++row) {pixelKernels().rotate(reinterpret_cast<uint32_t*>(fb.row(row)), fb.w, true);}
+	}
+	static void pixelARGBtoRGBA(Framebuffer& fb) {
+		for(int32_t row = 0; fb.pixels != NULL && row < fb.h; ++row) {pixelKernels().rotate(reinterpret_cast<uint32_t*>(fb.row(row)), fb.w, false);}
+	}
+	static void pixelExpand(Framebuffer& dst, const IndexedFramebuffer& src, const uint32_t* palette) {
+		// Replace every index in src with its color from the 256 entry palette and write the result to dst
+		if(dst.pixels == NULL || src.pixels == NULL) {return;}
+		uint32_t values[256];
+		for(uint16_t i = 0; i < 256; ++i) {values[i] = dst.value(palette[i]);}
+		const int32_t w = std::min(dst.w, src.w), h = std::min(dst.h, src.h);
+		for(int32_t row = 0; row < h; ++row) {
+			pixelKernels().expand(reinterpret_cast<uint32_t*>(dst.row(row)), src.pixels + (size_t)row * src.pitch, values, w);
+		}
+	}
+	bool fillTexture(Texture* texture, uint32_t color) {
+		int32_t w, h;
+		getTextureSize(texture, &w, &h);
+		return fillTextureRect(texture, 0, 0, w, h, color);
+	}
+	bool fillTextureRect(Texture* texture, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+		Framebuffer fb = lockPixels(texture);
+		if(fb.pixels == NULL) {return false;}
+		pixelFillRect(fb, x, y, w, h, color);
+		unlockTexture(texture);
+		return true;
+	}
+	static SimdLevel getSimdLevel() {return pixelKernels().level;}
+	static void setSimdLevel(SimdLevel level) {
+		// Force a slower implementation (e.g. to benchmark), levels the CPU doesn't support fall back to the best supported one
+		// Safe while jobs draw, rows already started may finish with the old kernels (every level gives the same pixels)
+		activePixelKernels().store(&pixelKernelTables()[std::min<uint8_t>(level, SIMD_AVX2)], std::memory_order_release);
 	}
 	void drawTexture(Texture* texture) {
-		SDL_RenderCopy(renderer, *texture, NULL, NULL);
+		if(*texture != NULL) {queueCommand(CMD_TEXTURE, 0, *texture, {0, 0, _ww, _wh});}
+	}
+	bool beginTexture(Texture* texture, bool clear = false) {
+		// Draw into a SDL_TEXTUREACCESS_TARGET texture until endTexture, coordinates are the texture's pixels
+		int32_t w, h;
+		if(texture == NULL || !textureSize(*texture, &w, &h)) {return false;}
+		return beginTarget(*texture, 1, 1, clear);
+	}
+	void endTexture() {endTarget();}
+
+	// Layers, target textures that keep what is drawn into them between beginLayer and endLayer with the usual calls
+	// The visible layers are drawn over the frame in order every frame, so a layer that doesn't change costs one copy
+	Layer* createLayer(int16_t order = 0) {
+		// NULL when the renderer can't draw into textures
+		if(!SDL_RenderTargetSupported(renderer)) {return NULL;}
+		std::unique_ptr<Layer> layer(new Layer{NULL, 0, 0, order, true, true});
+		if(!allocLayer(*layer)) {return NULL;}
+		return insertLayer(std::move(layer));
+	}
+	bool destroyLayer(Layer* layer) {
+		auto found = findLayer(layer);
+		if(found == layers.end()) {return false;}
+		if(renderTarget == layer->texture) {endTarget();}
+		if(layer->texture != NULL) {SDL_DestroyTexture(layer->texture);}
+		layers.erase(found);
+		return true;
+	}
+	bool beginLayer(Layer* layer, bool clear = true) {
+		// A dirty layer (new, resized or lost by the renderer) is always cleared to transparent, clear() would fill it with the background
+		// Coordinates stay in window units while the layer has as many pixels as the output (high DPI)
+		if(layer == NULL || layer->texture == NULL) {return false;}
+		if(!beginTarget(layer->texture, (float)layer->w / _ww, (float)layer->h / _wh, clear || layer->dirty)) {return false;}
+		layer->dirty = false;
+		return true;
+	}
+	void endLayer() {endTarget();}
+	bool isLayerDirty(Layer* layer) {return layer->dirty;}
+	void markLayerDirty(Layer* layer) {layer->dirty = true;}
+	void setLayerVisible(Layer* layer, bool visible) {layer->visible = visible;}
+	void setLayerOrder(Layer* layer, int16_t order) {
+		auto found = findLayer(layer);
+		if(found == layers.end() || layer->order == order) {return;}
+		std::unique_ptr<Layer> moved = std::move(*found);
+		layers.erase(found);
+		moved->order = order;
+		insertLayer(std::move(moved));
+	}
+	void drawLayers(int16_t maxOrder = INT16_MAX) {
+		// Layers up to maxOrder are drawn now, under everything drawn after, the rest still covers the frame at the end
+		if(renderTarget == NULL) {compositeLayers(maxOrder);}
+	}
+
+	// Canvas, CPU rasterizer that draws shapes straight into a Framebuffer as clipped row spans (colors are 0xRRGGBBAA)
+	struct Canvas {
+		Framebuffer fb;
+		SDL_Rect clip;
+
+		Canvas(const Framebuffer& fb) : fb(fb), clip({0, 0, fb.pixels != NULL ? fb.w : 0, fb.pixels != NULL ? fb.h : 0}) {}
+
+		void setClip(int32_t x, int32_t y, int32_t w, int32_t h) {
+			if(!clipPixelRect(fb.w, fb.h, x, y, w, h) || fb.pixels == NULL) {w = h = 0;}
+			clip = {x, y, w, h};
+		}
+		void resetClip() {setClip(0, 0, fb.w, fb.h);}
+		void clear(uint32_t color) {
+			// Replaces the pixels inside the clip rectangle instead of blending
+			const uint32_t value = fb.value(color);
+			for(int32_t y = clip.y; y < clip.y + clip.h; ++y) {pixelKernels().fill(reinterpret_cast<uint32_t*>(fb.at(clip.x, y)), value, clip.w);}
+			fb.markDirty(clip.x, clip.y, clip.w, clip.h);
+		}
+		void span(int32_t y, int32_t x1, int32_t x2, uint32_t color) {
+			// Pixels x1 <= x < x2 of row y
+			rawSpan(y, x1, x2, color);
+			fb.markDirty(x1, y, x2 - x1, 1);
+		}
+		void pixel(int32_t x, int32_t y, uint32_t color = 0xFFFFFFFF) {span(y, x, x + 1, color);}
+		void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color = 0xFFFFFFFF) {
+			for(int32_t row = std::max(y, clip.y); row < std::min(y + h, clip.y + clip.h); ++row) {rawSpan(row, x, x + w, color);}
+			fb.markDirty(x, y, w, h);
+		}
+		void rect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color = 0xFFFFFFFF) {
+			if(w <= 0 || h <= 0) {return;}
+			rawSpan(y, x, x + w, color);
+			for(int32_t row = std::max(y + 1, clip.y); row < std::min(y + h - 1, clip.y + clip.h); ++row) {
+				rawSpan(row, x, x + 1, color);
+				if(w > 1) {rawSpan(row, x + w - 1, x + w, color);}
+			}
+			if(h > 1) {rawSpan(y + h - 1, x, x + w, color);}
+			fb.markDirty(x, y, w, h);
+		}
+		void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t color = 0xFFFFFFFF) {
+			bresenham(x1, y1, x2, y2, color, true);
+			fb.markDirty(std::min(x1, x2), std::min(y1, y2), abs(x2 - x1) + 1, abs(y2 - y1) + 1);
+		}
+		void aaLine(float x1, float y1, float x2, float y2, uint32_t color = 0xFFFFFFFF) {
+			// Xiaolin Wu's line, each pixel is blended with its coverage times the alpha of color
+			const bool steep = fabsf(y2 - y1) > fabsf(x2 - x1);
+			if(steep) {std::swap(x1, y1); std::swap(x2, y2);}
+			if(x1 > x2) {std::swap(x1, x2); std::swap(y1, y2);}
+			const float gradient = x2 - x1 == 0 ? 1 : (y2 - y1) / (x2 - x1);
+			auto plot = [&](int32_t major, int32_t minor, float coverage) {
+				const uint32_t a = (uint32_t)((color & 0xFF) * coverage + 0.5f);
+				if(steep) {rawSpan(major, minor, minor + 1, (color & 0xFFFFFF00) | a);}
+				else {rawSpan(minor, major, major + 1, (color & 0xFFFFFF00) | a);}
+			};
+			auto endpoint = [&](float x, float y, bool first) {
+				const float xEnd = floorf(x + 0.5f), yEnd = y + gradient * (xEnd - x);
+				const float gap = first ? 1 - (x + 0.5f - floorf(x + 0.5f)) : x + 0.5f - floorf(x + 0.5f);
+				const float f = yEnd - floorf(yEnd);
+				plot((int32_t)xEnd, (int32_t)floorf(yEnd), (1 - f) * gap);
+				plot((int32_t)xEnd, (int32_t)floorf(yEnd) + 1, f * gap);
+				return (int32_t)xEnd;
+			};
+			const int32_t start = endpoint(x1, y1, true), end = endpoint(x2, y2, false);
+			// Only walk the part of the major axis that is inside the clip rectangle
+			const int32_t lo = std::max(start + 1, steep ? clip.y : clip.x), hi = std::min(end, steep ? clip.y + clip.h : clip.x + clip.w);
+			float y = y1 + gradient * (lo - x1);
+			for(int32_t x = lo; x < hi; ++x, y += gradient) {
+				const float f = y - floorf(y);
+				plot(x, (int32_t)floorf(y), 1 - f);
+				plot(x, (int32_t)floorf(y) + 1, f);
+			}
+			const int32_t minX = (int32_t)floorf(std::min(x1, x2)) - 1, minY = (int32_t)floorf(std::min(y1, y2)) - 1;
+			const int32_t spanX = (int32_t)fabsf(x2 - x1) + 4, spanY = (int32_t)fabsf(y2 - y1) + 4;
+			if(steep) {fb.markDirty(minY, minX, spanY, spanX);}
+			else {fb.markDirty(minX, minY, spanX, spanY);}
+		}
+		void circle(int32_t x, int32_t y, int32_t radius, uint32_t color = 0xFFFFFFFF) {ellipse(x, y, radius, radius, color);}
+		void fillCircle(int32_t x, int32_t y, int32_t radius, uint32_t color = 0xFFFFFFFF) {fillEllipse(x, y, radius, radius, color);}
+		void ellipse(int32_t x, int32_t y, int32_t rx, int32_t ry, uint32_t color = 0xFFFFFFFF) {
+			// Outlines are the filled shape minus the shape 1 pixel smaller, so no pixel is blended twice
+			if(rx < 0 || ry < 0) {return;}
+			for(int32_t dy = -ry; dy <= ry; ++dy) {
+				if(y + dy < clip.y || y + dy >= clip.y + clip.h) {continue;}
+				const int32_t outer = ellipseHalfWidth(dy, rx, ry);
+				const int32_t inner = rx > 0 && ry > 0 ? ellipseHalfWidth(dy, rx - 1, ry - 1) : -1;
+				ringSpan(y + dy, x - outer, x + outer + 1, x - inner, x + inner + 1, color);
+			}
+			fb.markDirty(x - rx, y - ry, rx * 2 + 1, ry * 2 + 1);
+		}
+		void fillEllipse(int32_t x, int32_t y, int32_t rx, int32_t ry, uint32_t color = 0xFFFFFFFF) {
+			if(rx < 0 || ry < 0) {return;}
+			for(int32_t row = std::max(y - ry, clip.y); row <= std::min(y + ry, clip.y + clip.h - 1); ++row) {
+				const int32_t half = ellipseHalfWidth(row - y, rx, ry);
+				rawSpan(row, x - half, x + half + 1, color);
+			}
+			fb.markDirty(x - rx, y - ry, rx * 2 + 1, ry * 2 + 1);
+		}
+		void roundedRectangle(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color = 0xFFFFFFFF) {
+			if(w <= 0 || h <= 0) {return;}
+			radius = std::max(0, std::min(radius, std::min(w, h) / 2));
+			for(int32_t row = std::max(y, clip.y); row < std::min(y + h, clip.y + clip.h); ++row) {
+				int32_t l, r, il = 0, ir = 0;
+				roundedRow(row, x, y, w, h, radius, l, r);
+				if(w > 2 && h > 2 && row > y && row < y + h - 1) {roundedRow(row, x + 1, y + 1, w - 2, h - 2, std::max(radius - 1, 0), il, ir);}
+				ringSpan(row, l, r, il, ir, color);
+			}
+			fb.markDirty(x, y, w, h);
+		}
+		void fillRoundedRectangle(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color = 0xFFFFFFFF) {
+			if(w <= 0 || h <= 0) {return;}
+			radius = std::max(0, std::min(radius, std::min(w, h) / 2));
+			for(int32_t row = std::max(y, clip.y); row < std::min(y + h, clip.y + clip.h); ++row) {
+				int32_t l, r;
+				roundedRow(row, x, y, w, h, radius, l, r);
+				rawSpan(row, l, r, color);
+			}
+			fb.markDirty(x, y, w, h);
+		}
+		void triangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint32_t color = 0xFFFFFFFF) {
+			const int16_t xs[3] = {(int16_t)x1, (int16_t)x2, (int16_t)x3}, ys[3] = {(int16_t)y1, (int16_t)y2, (int16_t)y3};
+			polygon(3, xs, ys, color);
+		}
+		void fillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint32_t color = 0xFFFFFFFF) {
+			const int16_t xs[3] = {(int16_t)x1, (int16_t)x2, (int16_t)x3}, ys[3] = {(int16_t)y1, (int16_t)y2, (int16_t)y3};
+			fillPolygon(3, xs, ys, color);
+		}
+		void polygon(uint32_t numPts, const int16_t* x, const int16_t* y, uint32_t color = 0xFFFFFFFF) {
+			// Every edge leaves out its last pixel, which is the first pixel of the next edge
+			if(numPts == 0) {return;}
+			if(numPts == 1) {pixel(x[0], y[0], color); return;}
+			int32_t minX = x[0], minY = y[0], maxX = x[0], maxY = y[0];
+			for(uint32_t i = 0; i < numPts; ++i) {
+				const uint32_t j = (i + 1) % numPts;
+				if(x[i] != x[j] || y[i] != y[j]) {bresenham(x[i], y[i], x[j], y[j], color, false);}
+				minX = std::min(minX, (int32_t)x[i]); maxX = std::max(maxX, (int32_t)x[i]);
+				minY = std::min(minY, (int32_t)y[i]); maxY = std::max(maxY, (int32_t)y[i]);
+			}
+			fb.markDirty(minX, minY, maxX - minX + 1, maxY - minY + 1);
+		}
+		void fillPolygon(uint32_t numPts, const int16_t* x, const int16_t* y, uint32_t color = 0xFFFFFFFF) {
+			// Scanline fill with the even-odd rule, a pixel is inside when its center is. Vertices are pixel corners so a polygon
+			// from 0, 0 to 10, 10 covers the same pixels as fillRect(0, 0, 10, 10)
+			if(numPts < 3) {return;}
+			int32_t minX = x[0], minY = y[0], maxX = x[0], maxY = y[0];
+			for(uint32_t i = 1; i < numPts; ++i) {
+				minX = std::min(minX, (int32_t)x[i]); maxX = std::max(maxX, (int32_t)x[i]);
+				minY = std::min(minY, (int32_t)y[i]); maxY = std::max(maxY, (int32_t)y[i]);
+			}
+			for(int32_t row = std::max(minY, clip.y); row < std::min(maxY, clip.y + clip.h); ++row) {
+				const float cy = row + 0.5f;
+				crossings.clear();
+				for(uint32_t i = 0; i < numPts; ++i) {
+					const uint32_t j = (i + 1) % numPts;
+					if((y[i] <= cy) == (y[j] <= cy)) {continue;}
+					crossings.push_back(x[i] + (cy - y[i]) * (x[j] - x[i]) / (float)(y[j] - y[i]));
+				}
+				std::sort(crossings.begin(), crossings.end());
+				for(size_t i = 0; i + 1 < crossings.size(); i += 2) {
+					rawSpan(row, (int32_t)ceilf(crossings[i] - 0.5f), (int32_t)ceilf(crossings[i+1] - 0.5f), color);
+				}
+			}
+			fb.markDirty(minX, minY, maxX - minX, maxY - minY);
+		}
+
+	private:
+		std::vector<float> crossings;
+
+		void rawSpan(int32_t y, int32_t x1, int32_t x2, uint32_t color) {
+			// Opaque spans are filled, translucent ones blended, both with the SIMD pixel kernels
+			const uint8_t a = color & 0xFF;
+			if(a == 0 || y < clip.y || y >= clip.y + clip.h) {return;}
+			x1 = std::max(x1, clip.x);
+			x2 = std::min(x2, clip.x + clip.w);
+			if(x2 <= x1) {return;}
+			uint32_t* row = reinterpret_cast<uint32_t*>(fb.at(x1, y));
+			if(a == 255) {pixelKernels().fill(row, fb.value(color), x2 - x1);}
+			else {pixelKernels().blendColor(row, fb.value(color), x2 - x1);}
+		}
+		void ringSpan(int32_t y, int32_t l, int32_t r, int32_t il, int32_t ir, uint32_t color) {
+			// Row of a shape outline: l <= x < r without the hole il <= x < ir
+			if(il >= ir) {rawSpan(y, l, r, color); return;}
+			rawSpan(y, l, il, color);
+			rawSpan(y, ir, r, color);
+		}
+		void bresenham(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t color, bool last) {
+			// Pixels on the same row are collected into one span, so mostly horizontal lines are only a few fills
+			if(std::max(x1, x2) < clip.x || std::min(x1, x2) >= clip.x + clip.w || std::max(y1, y2) < clip.y || std::min(y1, y2) >= clip.y + clip.h) {return;}
+			const int32_t dx = abs(x2 - x1), dy = -abs(y2 - y1), sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1;
+			int32_t err = dx + dy, runX = x1;
+			while(true) {
+				const bool end = x1 == x2 && y1 == y2;
+				const int32_t e2 = 2 * err;
+				const bool stepY = !end && e2 <= dx;
+				if(end && !last) {
+					// The run ends before the final pixel
+					if(runX != x1) {rawSpan(y1, std::min(runX, x1 - sx), std::max(runX, x1 - sx) + 1, color);}
+					break;
+				}
+				if(end || stepY) {rawSpan(y1, std::min(runX, x1), std::max(runX, x1) + 1, color);}
+				if(end) {break;}
+				if(e2 >= dy) {err += dy; x1 += sx;}
+				if(stepY) {err += dx; y1 += sy; runX = x1;}
+			}
+		}
+		static int32_t ellipseHalfWidth(int32_t dy, int32_t rx, int32_t ry) {
+			// Half the width of row dy of an ellipse centered on a pixel, -1 when the row is outside
+			if(abs(dy) > ry) {return -1;}
+			const double t = dy / (ry + 0.5);
+			return (int32_t)((rx + 0.5) * sqrt(1.0 - t * t));
+		}
+		static void roundedRow(int32_t row, int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, int32_t& l, int32_t& r) {
+			// Horizontal extent l <= x < r of a row of a rounded rectangle
+			l = x;
+			r = x + w;
+			const int32_t dy = row < y + radius ? y + radius - row : row > y + h - 1 - radius ? row - (y + h - 1 - radius) : 0;
+			if(dy == 0) {return;}
+			const int32_t inset = radius - std::max(ellipseHalfWidth(dy, radius, radius), 0);
+			l += inset;
+			r -= inset;
+		}
+	};
+	Canvas lockCanvas(Texture* texture) {
+		// Draws into the texture's CPU copy (see lockFramebuffer), the region that changed is uploaded by unlockCanvas
+		return Canvas(lockFramebuffer(texture));
 	}
+	void unlockCanvas(Texture* texture, Canvas& canvas) {unlockFramebuffer(texture, canvas.fb);}
 
 
 	// Graphics
 	void clear() {
-		setColor(background.r, background.g, background.b, background.a);
-		SDL_RenderClear(renderer);
+		if(renderTarget == NULL) {layersDrawnTo = INT32_MIN;}
+		queueCommand(CMD_CLEAR, packColor(background.r, background.g, background.b, background.a), NULL, {0, 0, _ww, _wh});
 	}
 	void pixel(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-		setColor(r, g, b, a);
-		SDL_RenderDrawPoint(renderer, x, y);
+		queueCommand(CMD_POINT, packColor(r, g, b, a), NULL, {x, y, 1, 1});
 	}
 	void pixel(int32_t x, int32_t y, uint32_t color = 0xFFFFFFFF) {
-		setColor(color);
-		SDL_RenderDrawPoint(renderer, x, y);
+		queueCommand(CMD_POINT, color, NULL, {x, y, 1, 1});
 	}
 	void fillRect(int32_t x, int32_t y, uint16_t w, uint16_t h, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-		setColor(r, g, b, a);
-		SDL_Rect rect = {x, y, w, h};
-		SDL_RenderFillRect(renderer, &rect);
+		queueCommand(CMD_FILL_RECT, packColor(r, g, b, a), NULL, {x, y, w, h});
 	}
 	void fillRect(int32_t x, int32_t y, uint16_t w, uint16_t h, uint32_t color = 0xFFFFFFFF) {
-		setColor(color);
-		SDL_Rect rect = {x, y, w, h};
-		SDL_RenderFillRect(renderer, &rect);
+		queueCommand(CMD_FILL_RECT, color, NULL, {x, y, w, h});
 	}
 	void rect(int32_t x, int32_t y, uint16_t w, uint16_t h, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-		setColor(r, g, b, a);
-		SDL_Rect rect = {x, y, w, h};
-		SDL_RenderDrawRect(renderer, &rect);
+		queueCommand(CMD_RECT, packColor(r, g, b, a), NULL, {x, y, w, h});
 	}
 	void rect(int32_t x, int32_t y, uint16_t w, uint16_t h, uint32_t color = 0xFFFFFFFF) {
-		setColor(color);
-		SDL_Rect rect = {x, y, w, h};
-		SDL_RenderDrawRect(renderer, &rect);
+		queueCommand(CMD_RECT, color, NULL, {x, y, w, h});
+	}
+
+	// Input Recording (handled events and the deltaTime of every frame are saved so a run can be repeated exactly)
+	bool startRecording(const char* file) {
+		stopRecording();
+		if(replaying) {return false;}
+		recordFile = fopen(file, "wb");
+		if(recordFile == NULL) {return false;}
+		const uint8_t magic[4] = {'A', 'R', 'G', 'R'};
+		recordBuffer.assign(magic, magic + 4);
+		recordValue(RECORD_VERSION);
+		recordValue(_ww);
+		recordValue(_wh);
+		recordValue(_mx);
+		recordValue(_my);
+		return true;
+	}
+	void stopRecording() {
+		if(recordFile == NULL) {return;}
+		fwrite(recordBuffer.data(), 1, recordBuffer.size(), recordFile);
+		fclose(recordFile);
+		recordFile = NULL;
+		recordBuffer.clear();
+	}
+	bool startReplay(const char* file, bool realtime = true) {
+		// From the next frame on the recorded events replace live input, the app stops when the recording ends
+		stopRecording();
+		stopReplay();
+		FILE* in = fopen(file, "rb");
+		if(in == NULL) {return false;}
+		uint8_t chunk[4096];
+		for(size_t n; (n = fread(chunk, 1, sizeof(chunk), in)) > 0;) {replayData.insert(replayData.end(), chunk, chunk + n);}
+		fclose(in);
+		uint8_t version = 0;
+		uint16_t w, h, mx, my;
+		replayPos = 4;
+		if(replayData.size() < 4 || memcmp(replayData.data(), "ARGR", 4) != 0 || !replayRead(version) || version != RECORD_VERSION ||
+		   !replayRead(w) || !replayRead(h) || !replayRead(mx) || !replayRead(my)) {
+			stopReplay();
+			return false;
+		}
+		_mx = input.x = mx;
+		_my = input.y = my;
+		if(window != NULL && (w != _ww || h != _wh)) {
+			SDL_SetWindowSize(window, w, h);
+			_ww = w;
+			_wh = h;
+			applyResize();
+		}
+		replaying = true;
+		replayRealtime = realtime;
+		replayClock = 0;
+		replayStart = SDL_GetPerformanceCounter();
+		return true;
+	}
+	void stopReplay() {
+		replaying = false;
+		replayData.clear();
+		replayData.shrink_to_fit();
+		replayPos = 0;
+	}
+
+	// Frame Capture (finished frames are read back into pooled buffers and encoded to a file on a background thread)
+	bool startCapture(const char* file, CaptureFormat format = CAPTURE_GIF, CapturePolicy policy = CAPTURE_DROP, uint16_t fps = 0) {
+		stopCapture();
+		int32_t w = 0, h = 0;
+		if(SDL_GetRendererOutputSize(renderer, &w, &h) != 0 || w <= 0 || h <= 0 || (format == CAPTURE_GIF && (w > 65535 || h > 65535))) {return false;}
+		capture.file = fopen(file, "wb");
+		if(capture.file == NULL) {return false;}
+		capture.format = format;
+		capture.policy = policy;
+		capture.w = w;
+		capture.h = h;
+		capture.fps = fps > 0 ? fps : targetFps > 0 ? (uint16_t)std::max(std::lround(targetFps), 1L) : 60;
+		capture.stats = {0, 0};
+		capture.skipped = 0;
+		capture.time = 0;
+		capture.quit = false;
+		capture.pool.resize(ARGON_CAPTURE_BUFFERS);
+		for(CaptureFrame& frame : capture.pool) {
+			frame.pixels.resize((size_t)w * h * 4);
+			capture.free.push_back(&frame);
+		}
+		if(format == CAPTURE_Y4M) {fprintf(capture.file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", w, h, capture.fps);}
+		else if(format == CAPTURE_GIF) {
+			// Header without a global palette (every frame has its own) and the extension that makes the animation loop
+			const uint8_t header[] = {'G', 'I', 'F', '8', '9', 'a', (uint8_t)w, (uint8_t)(w >> 8), (uint8_t)h, (uint8_t)(h >> 8), 0, 0, 0,
+			                          0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0};
+			fwrite(header, 1, sizeof(header), capture.file);
+		}
+		capture.thread = std::thread(&Argon::captureWorker, this);
+		return true;
+	}
+	void stopCapture() {
+		// Waits until every queued frame is written
+		if(capture.file == NULL) {return;}
+		{
+			std::lock_guard<std::mutex> lock(capture.mutex);
+			capture.quit = true;
+		}
+		capture.cv.notify_all();
+		capture.thread.join();
+		if(capture.format == CAPTURE_GIF) {
+			captureFlushGIF();
+			fputc(0x3B, capture.file);
+		}
+		fclose(capture.file);
+		capture.file = NULL;
+		capture.free.clear();
+		capture.pool.clear();
+		capture.previous.clear();
+		capture.previous.shrink_to_fit();
+	}
+
+	// Profiler
+	void setProfiling(bool val) {
+		profiling = val;
+		if(val && profilePhases.empty()) {
+			for(const char* name : {"frame", "events", "gameLoop", "texture", "flush", "wait", "present", "capture"}) {profilePhases.push_back({name, 0, std::vector<float>(ARGON_PROFILE_FRAMES, 0.0f), 0});}
+		}
+	}
+	void setProfilerOverlay(bool val) {
+		if(val) {setProfiling(true);}
+		profilerOverlay = val;
+	}
+	void beginScope(const char* name) {
+		if(!profiling) {return;}
+		profileScopes.push_back({profilePhase(name), SDL_GetPerformanceCounter()});
+	}
+	void endScope() {
+		if(!profiling || profileScopes.empty()) {return;}
+		profileEnd(profileScopes.back().first, profileScopes.back().second);
+		profileScopes.pop_back();
+	}
+	struct ProfileScope {
+		Argon& argon;
+		ProfileScope(Argon& argon, const char* name) : argon(argon) {argon.beginScope(name);}
+		~ProfileScope() {argon.endScope();}
+	};
+	ProfileStats getProfileStats(const char* name) {
+		ProfileStats stats = {0, 0, 0, 0};
+		if(!profiling) {return stats;}
+		int32_t phase = findProfilePhase(name);
+		if(phase < 0 || profilePhases[phase].frames == 0) {return stats;}
+		// Only the frames since the phase was created, a scope added later doesn't average in zeros from before it existed
+		std::vector<float>& history = profilePhases[phase].history;
+		uint32_t frames = profilePhases[phase].frames;
+		profileScratch.clear();
+		for(uint32_t i = 0; i < frames; ++i) {profileScratch.push_back(history[(profileIndex + ARGON_PROFILE_FRAMES - frames + i) % ARGON_PROFILE_FRAMES]);}
+		size_t p99 = (profileScratch.size() - 1) * 99 / 100;
+		std::nth_element(profileScratch.begin(), profileScratch.begin() + p99, profileScratch.end());
+		stats.p99Ms = profileScratch[p99];
+		stats.minMs = stats.maxMs = profileScratch[0];
+		for(float v : profileScratch) {
+			stats.avgMs += v;
+			stats.minMs = v < stats.minMs ? v : stats.minMs;
+			stats.maxMs = v > stats.maxMs ? v : stats.maxMs;
+		}
+		stats.avgMs /= profileScratch.size();
+		return stats;
+	}
+	std::vector<uint32_t> getFrameHistogram(double binMs = 1.0, uint16_t bins = 34) {
+		// The last bin counts every frame that took longer than the other bins cover
+		std::vector<uint32_t> histogram(bins, 0);
+		if(!profiling || bins == 0 || !(binMs > 0)) {return histogram;}
+		for(uint32_t i = 0; i < profileFrames; ++i) {
+			double bin = profilePhases[PHASE_FRAME].history[i] / binMs;
+			++histogram[bin < bins ? (uint32_t)bin : bins - 1];
+		}
+		return histogram;
+	}
+	void printProfile(FILE* out = stdout) {
+		if(!profiling) {return;}
+		fprintf(out, "%-20s %10s %10s %10s %10s\n", "phase (ms)", "min", "avg", "p99", "max");
+		for(ProfilePhase& phase : profilePhases) {
+			ProfileStats stats = getProfileStats(phase.name.c_str());
+			fprintf(out, "%-20s %10.3f %10.3f %10.3f %10.3f\n", phase.name.c_str(), stats.minMs, stats.avgMs, stats.p99Ms, stats.maxMs);
+		}
+	}
+
+	// Deferred Rendering (draw calls are recorded and submitted sorted by state right before the frame is presented)
+	void setDeferred(bool val) {
+		if(!val) {flushCommands();}
+		deferred = val;
+	}
+	bool isDeferred() {return deferred;}
+	DrawStats getDrawStats() {return lastDrawStats;}
+
+	// Batched Graphics (primitives are collected and submitted in as few SDL calls as possible on end*())
+	void beginPoints() {beginBatch(BATCH_POINTS);}
+	void point(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {point(x, y, packColor(r, g, b, a));}
+	void point(int32_t x, int32_t y, uint32_t color = 0xFFFFFFFF) {
+		// Outside a batch of points the point is drawn on its own
+		if(batchType != BATCH_POINTS) {pixel(x, y, color); return;}
+		batchColors.push_back(color);
+		batchPoints.push_back({x, y});
+	}
+	void endPoints() {flushBatch();}
+	void beginRects(bool filled = true) {beginBatch(filled ? BATCH_FILL_RECTS : BATCH_RECTS);}
+	void addRect(int32_t x, int32_t y, uint16_t w, uint16_t h, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {addRect(x, y, w, h, packColor(r, g, b, a));}
+	void addRect(int32_t x, int32_t y, uint16_t w, uint16_t h, uint32_t color = 0xFFFFFFFF) {
+		if(batchType != BATCH_RECTS && batchType != BATCH_FILL_RECTS) {fillRect(x, y, w, h, color); return;}
+		batchColors.push_back(color);
+		batchRects.push_back({x, y, w, h});
+	}
+	void endRects() {flushBatch();}
+	void beginLines(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {beginLines(packColor(r, g, b, a));}
+	void beginLines(uint32_t color = 0xFFFFFFFF) {
+		beginBatch(BATCH_LINES);
+		batchColors.push_back(color);
+	}
+	void vertex(int32_t x, int32_t y) {
+		// A vertex has nothing to connect to outside a line strip
+		if(batchType != BATCH_LINES) {return;}
+		batchPoints.push_back({x, y});
+	}
+	void endLines() {flushBatch();}
+
+	// Instanced Circles (every circle is a quad of a circle rasterized once, anti-aliased if setAntiAlias is on)
+	void circles(const Circle* circles, uint32_t count) {
+		Atlas& sheet = circleSheet(antiAlias);
+		if(sheet.pages.empty()) {return;}
+		if(!commands.empty()) {flushCommands();}
+		const AtlasPage& page = sheet.pages[0];
+		for(uint32_t i = 0; i < count; ++i) {
+			const Circle& c = circles[i];
+			if(!(c.radius > 0) || (c.color & 0xFF) == 0) {continue;}
+			// Smallest baked circle at least as wide as this one, so it's scaled down by at most half
+			size_t level = circleCells.size() - 1;
+			while(level > 0 && circleCells[level].w - 2 < c.radius * 2) {--level;}
+			const SDL_Rect& cell = circleCells[level];
+			const float half = c.radius * cell.w / (cell.w - 2); // The cell has a transparent 1px border around the circle
+			const SDL_FPoint corners[4] = {{c.x - half, c.y - half}, {c.x + half, c.y - half}, {c.x + half, c.y + half}, {c.x - half, c.y + half}};
+			queueQuad(page, cell, corners, {(uint8_t)(c.color>>24), (uint8_t)(c.color>>16), (uint8_t)(c.color>>8), (uint8_t)c.color});
+		}
+	}
+
+	// Sprites (images are packed into shared atlas textures when loaded and drawn as textured quads)
+	Sprite loadSprite(const char* file) {
+		SDL_Surface* surface = SDL_LoadBMP(file);
+		if(surface == NULL) {return 0;}
+		Sprite sprite = loadSprite(surface);
+		SDL_FreeSurface(surface);
+		return sprite;
+	}
+	Sprite loadSprite(SDL_Surface* surface, const SDL_Rect* region = NULL) {
+		SDL_Surface* rgba = spriteSurface(surface);
+		if(rgba == NULL) {return 0;}
+		SDL_Rect rect = region != NULL ? *region : SDL_Rect{0, 0, rgba->w, rgba->h};
+		Sprite sprite = packSprite(rgba, rect);
+		if(rgba != surface) {SDL_FreeSurface(rgba);}
+		return sprite;
+	}
+	Sprite loadSpriteSheet(const char* file, int32_t w, int32_t h) {
+		// Cells are read row by row, the sprites of the sheet are the returned sprite, sprite + 1, ...
+		SDL_Surface* surface = SDL_LoadBMP(file);
+		if(surface == NULL || w <= 0 || h <= 0) {
+			if(surface != NULL) {SDL_FreeSurface(surface);}
+			return 0;
+		}
+		SDL_Surface* rgba = spriteSurface(surface);
+		Sprite first = 0;
+		for(int32_t y = 0; rgba != NULL && y + h <= rgba->h; y += h) {
+			for(int32_t x = 0; x + w <= rgba->w; x += w) {
+				Sprite sprite = packSprite(rgba, {x, y, w, h});
+				if(first == 0) {first = sprite;}
+			}
+		}
+		if(rgba != NULL && rgba != surface) {SDL_FreeSurface(rgba);}
+		SDL_FreeSurface(surface);
+		return first;
+	}
+	bool loadSprites(const char* const* files, uint32_t count, Sprite* out) {
+		// Packs the images tallest first which wastes less atlas space than packing them in any order
+		std::vector<SDL_Surface*> surfaces(count, NULL);
+		std::vector<uint32_t> order;
+		bool loaded = true;
+		for(uint32_t i = 0; i < count; ++i) {
+			out[i] = 0;
+			SDL_Surface* surface = SDL_LoadBMP(files[i]);
+			if(surface != NULL) {
+				surfaces[i] = spriteSurface(surface);
+				if(surfaces[i] != surface) {SDL_FreeSurface(surface);}
+			}
+			if(surfaces[i] != NULL) {order.push_back(i);}
+			else {loaded = false;}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {return surfaces[a]->h > surfaces[b]->h;});
+		for(uint32_t i : order) {
+			out[i] = packSprite(surfaces[i], {0, 0, surfaces[i]->w, surfaces[i]->h});
+			loaded &= out[i] != 0;
+			SDL_FreeSurface(surfaces[i]);
+		}
+		return loaded;
+	}
+	void getSpriteSize(Sprite sprite, int32_t* w, int32_t* h) {
+		if(sprite == 0 || sprite > sprites.size()) {
+			*w = *h = 0;
+			return;
+		}
+		*w = sprites[sprite - 1].rect.w;
+		*h = sprites[sprite - 1].rect.h;
+	}
+	void freeSprites() {
+		atlasFree(spriteAtlas);
+		sprites.clear();
+		#if SDL_VERSION_ATLEAST(2, 0, 18)
+			spriteBuckets.clear();
+		#endif
+	}
+	void beginSprites() {spriteBatch = true;}
+	void sprite(Sprite sprite, float x, float y, float scale = 1, float angle = 0, uint32_t tint = 0xFFFFFFFF) {
+		if(sprite == 0 || sprite > sprites.size()) {return;}
+		const SDL_Rect& rect = sprites[sprite - 1].rect;
+		this->sprite(sprite, SDL_FRect{x, y, rect.w * scale, rect.h * scale}, angle, tint);
+	}
+	void sprite(Sprite sprite, SDL_FRect dst, float angle = 0, uint32_t tint = 0xFFFFFFFF) {
+		if(sprite == 0 || sprite > sprites.size()) {return;}
+		const SpriteInfo& info = sprites[sprite - 1];
+		SDL_FPoint corners[4] = {{dst.x, dst.y}, {dst.x + dst.w, dst.y}, {dst.x + dst.w, dst.y + dst.h}, {dst.x, dst.y + dst.h}};
+		if(angle != 0) {
+			// Clockwise in degrees around the center, like SDL_RenderCopyEx
+			const float rad = angle * (float)M_PI / 180, c = std::cos(rad), s = std::sin(rad);
+			const float cx = dst.x + dst.w / 2, cy = dst.y + dst.h / 2;
+			for(SDL_FPoint& p : corners) {
+				const float dx = p.x - cx, dy = p.y - cy;
+				p = {cx + dx * c - dy * s, cy + dx * s + dy * c};
+			}
+		}
+		SDL_Color color = {(uint8_t)(tint>>24), (uint8_t)(tint>>16), (uint8_t)(tint>>8), (uint8_t)tint};
+		#if SDL_VERSION_ATLEAST(2, 0, 18)
+			if(spriteBatch) {
+				if(spriteBuckets.size() <= info.page) {spriteBuckets.resize(info.page + 1);}
+				std::vector<SDL_Vertex>& bucket = spriteBuckets[info.page];
+				bucket.resize(bucket.size() + 4);
+				makeQuad(&bucket[bucket.size() - 4], spriteAtlas.pages[info.page], info.rect, corners, color);
+				return;
+			}
+		#endif
+		if(!commands.empty()) {flushCommands();}
+		queueQuad(spriteAtlas.pages[info.page], info.rect, corners, color);
+	}
+	void endSprites() {
+		// One SDL_RenderGeometry call per atlas texture
+		spriteBatch = false;
+		#if SDL_VERSION_ATLEAST(2, 0, 18)
+			flushCommands();
+			for(size_t page = 0; page < spriteBuckets.size(); ++page) {
+				if(spriteBuckets[page].empty()) {continue;}
+				drawQuads(spriteAtlas.pages[page].texture, spriteBuckets[page].data(), spriteBuckets[page].size());
+				spriteBuckets[page].clear();
+			}
+		#endif
 	}
 
 
 
 	#ifndef ARGON_INCLUDE_GFX
 		void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			setColor(r, g, b, a);
-			SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
+			queueCommand(CMD_LINE, packColor(r, g, b, a), NULL, {x1, y1, x2, y2});
 		}
 		void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t color = 0xFFFFFFFF) {
-			setColor(color);
-			SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
+			queueCommand(CMD_LINE, color, NULL, {x1, y1, x2, y2});
 		}
 		void hline(int32_t x1, int32_t x2, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			setColor(r, g, b, a);
-			SDL_RenderDrawLine(renderer, x1, y, x2, y);
+			queueCommand(CMD_LINE, packColor(r, g, b, a), NULL, {x1, y, x2, y});
 		}
 		void hline(int32_t x1, int32_t x2, int32_t y, uint32_t color = 0xFFFFFFFF) {
-			setColor(color);
-			SDL_RenderDrawLine(renderer, x1, y, x2, y);
+			queueCommand(CMD_LINE, color, NULL, {x1, y, x2, y});
 		}
 		void vline(int32_t x, int32_t y1, int32_t y2, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			setColor(r, g, b, a);
-			SDL_RenderDrawLine(renderer, x, y1, x, y2);
+			queueCommand(CMD_LINE, packColor(r, g, b, a), NULL, {x, y1, x, y2});
 		}
 		void vline(int32_t x, int32_t y1, int32_t y2, uint32_t color = 0xFFFFFFFF) {
-			setColor(color);
-			SDL_RenderDrawLine(renderer, x, y1, x, y2);
+			queueCommand(CMD_LINE, color, NULL, {x, y1, x, y2});
 		}
 	#else
 		void roundedRectangle(int32_t x, int32_t y, uint16_t w, uint16_t h, uint16_t radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			roundedRectangleRGBA(renderer, x, y, x+w, y+h, radius, r, g, b, a);
+			roundedRectangleRGBA(directRenderer(), x, y, x+w, y+h, radius, r, g, b, a);
 		}
 		void roundedRectangle(int32_t x, int32_t y, uint16_t w, uint16_t h, uint16_t radius, uint32_t color = 0xFFFFFFFF) {
-			roundedRectangleRGBA(renderer, x, y, x+w, y+h, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			roundedRectangleRGBA(directRenderer(), x, y, x+w, y+h, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void fillRoundedRectangle(int32_t x, int32_t y, uint16_t w, uint16_t h, uint16_t radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			roundedBoxRGBA(renderer, x, y, x+w, y+h, radius, r, g, b, a);
+			roundedBoxRGBA(directRenderer(), x, y, x+w, y+h, radius, r, g, b, a);
 		}
 		void fillRoundedRectangle(int32_t x, int32_t y, uint16_t w, uint16_t h, uint16_t radius, uint32_t color = 0xFFFFFFFF) {
-			roundedBoxRGBA(renderer, x, y, x+w, y+h, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			roundedBoxRGBA(directRenderer(), x, y, x+w, y+h, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aalineRGBA(renderer, x1, y1, x2, y2, r, g, b, a);
-			else aalineRGBA(renderer, x1, y1, x2, y2, r, g, b, a);
+			if(antiAlias) aalineRGBA(directRenderer(), x1, y1, x2, y2, r, g, b, a);
+			else aalineRGBA(directRenderer(), x1, y1, x2, y2, r, g, b, a);
 		}
 		void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aalineRGBA(renderer, x1, y1, x2, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else lineRGBA(renderer, x1, y1, x2, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aalineRGBA(directRenderer(), x1, y1, x2, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else lineRGBA(directRenderer(), x1, y1, x2, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void hline(int32_t x1, int32_t x2, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aalineRGBA(renderer, x1, y, x2, y, r, g, b, a);
-			else lineRGBA(renderer, x1, y, x2, y, r, g, b, a);
+			if(antiAlias) aalineRGBA(directRenderer(), x1, y, x2, y, r, g, b, a);
+			else lineRGBA(directRenderer(), x1, y, x2, y, r, g, b, a);
 		}
 		void hline(int32_t x1, int32_t x2, int32_t y, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aalineRGBA(renderer, x1, y, x2, y, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else lineRGBA(renderer, x1, y, x2, y, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aalineRGBA(directRenderer(), x1, y, x2, y, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else lineRGBA(directRenderer(), x1, y, x2, y, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void vline(int32_t x, int32_t y1, int32_t y2, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aalineRGBA(renderer, x, y1, x, y2, r, g, b, a);
-			else lineRGBA(renderer, x, y1, x, y2, r, g, b, a);
+			if(antiAlias) aalineRGBA(directRenderer(), x, y1, x, y2, r, g, b, a);
+			else lineRGBA(directRenderer(), x, y1, x, y2, r, g, b, a);
 		}
 		void vline(int32_t x, int32_t y1, int32_t y2, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aalineRGBA(renderer, x, y1, x, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else lineRGBA(renderer, x, y1, x, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aalineRGBA(directRenderer(), x, y1, x, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else lineRGBA(directRenderer(), x, y1, x, y2, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void thickLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t thickness, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			thickLineRGBA(renderer, x1, y1, x2, y2, thickness, r, g, b, a);
+			thickLineRGBA(directRenderer(), x1, y1, x2, y2, thickness, r, g, b, a);
 		}
 		void thickLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint8_t thickness, uint32_t color = 0xFFFFFFFF) {
-			thickLineRGBA(renderer, x1, y1, x2, y2, thickness, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			thickLineRGBA(directRenderer(), x1, y1, x2, y2, thickness, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void circle(int32_t x, int32_t y, uint16_t radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aacircleRGBA(renderer, x, y, radius, r, g, b, a);
-			else circleRGBA(renderer, x, y, radius, r, g, b, a);
+			if(antiAlias) aacircleRGBA(directRenderer(), x, y, radius, r, g, b, a);
+			else circleRGBA(directRenderer(), x, y, radius, r, g, b, a);
 		}
 		void circle(int32_t x, int32_t y, uint16_t radius, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aacircleRGBA(renderer, x, y, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else circleRGBA(renderer, x, y, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aacircleRGBA(directRenderer(), x, y, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else circleRGBA(directRenderer(), x, y, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void fillCircle(int32_t x, int32_t y, uint16_t radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			filledCircleRGBA(renderer, x, y, radius, r, g, b, a);
+			filledCircleRGBA(directRenderer(), x, y, radius, r, g, b, a);
 		}
 		void fillCircle(int32_t x, int32_t y, uint16_t radius, uint32_t color = 0xFFFFFFFF) {
-			filledCircleRGBA(renderer, x, y, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			filledCircleRGBA(directRenderer(), x, y, radius, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void ellipse(int32_t x, int32_t y, uint16_t rx, uint16_t ry, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aaellipseRGBA(renderer, x, y, rx, ry, r, g, b, a);
-			else ellipseRGBA(renderer, x, y, rx, ry, r, g, b, a);
+			if(antiAlias) aaellipseRGBA(directRenderer(), x, y, rx, ry, r, g, b, a);
+			else ellipseRGBA(directRenderer(), x, y, rx, ry, r, g, b, a);
 		}
 		void ellipse(int32_t x, int32_t y, uint16_t rx, uint16_t ry, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aaellipseRGBA(renderer, x, y, rx, ry, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else ellipseRGBA(renderer, x, y, rx, ry, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aaellipseRGBA(directRenderer(), x, y, rx, ry, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else ellipseRGBA(directRenderer(), x, y, rx, ry, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void fillEllipse(int32_t x, int32_t y, uint16_t rx, uint16_t ry, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			filledEllipseRGBA(renderer, x, y, rx, ry, r, g, b, a);
+			filledEllipseRGBA(directRenderer(), x, y, rx, ry, r, g, b, a);
 		}
 		void fillEllipse(int32_t x, int32_t y, uint16_t rx, uint16_t ry, uint32_t color = 0xFFFFFFFF) {
-			filledEllipseRGBA(renderer, x, y, rx, ry, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			filledEllipseRGBA(directRenderer(), x, y, rx, ry, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void arc(int32_t x, int32_t y, uint16_t radius, int16_t start, int16_t end, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			arcRGBA(renderer, x, y, radius, start, end, r, g, b, a);
+			arcRGBA(directRenderer(), x, y, radius, start, end, r, g, b, a);
 		}
 		void arc(int32_t x, int32_t y, uint16_t radius, int16_t start, int16_t end, uint32_t color = 0xFFFFFFFF) {
-			arcRGBA(renderer, x, y, radius, start, end, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			arcRGBA(directRenderer(), x, y, radius, start, end, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void triangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aatrigonRGBA(renderer, x1, y1, x2, y2, x3, y3, r, g, b, a);
-			else trigonRGBA(renderer, x1, y1, x2, y2, x3, y3, r, g, b, a);
+			if(antiAlias) aatrigonRGBA(directRenderer(), x1, y1, x2, y2, x3, y3, r, g, b, a);
+			else trigonRGBA(directRenderer(), x1, y1, x2, y2, x3, y3, r, g, b, a);
 		}
 		void triangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aatrigonRGBA(renderer, x1, y1, x2, y2, x3, y3, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else trigonRGBA(renderer, x1, y1, x2, y2, x3, y3, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aatrigonRGBA(directRenderer(), x1, y1, x2, y2, x3, y3, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else trigonRGBA(directRenderer(), x1, y1, x2, y2, x3, y3, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void fillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			filledTrigonRGBA(renderer, x1, y1, x2, y2, x3, y3, r, g, b, a);
+			filledTrigonRGBA(directRenderer(), x1, y1, x2, y2, x3, y3, r, g, b, a);
 		}
 		void fillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint32_t color = 0xFFFFFFFF) {
-			filledTrigonRGBA(renderer, x1, y1, x2, y2, x3, y3, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			filledTrigonRGBA(directRenderer(), x1, y1, x2, y2, x3, y3, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void polygon(uint8_t numPts, const int16_t* x, const int16_t* y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			if(antiAlias) aapolygonRGBA(renderer, x, y, numPts, r, g, b, a);
-			else polygonRGBA(renderer, x, y, numPts, r, g, b, a);
+			if(antiAlias) aapolygonRGBA(directRenderer(), x, y, numPts, r, g, b, a);
+			else polygonRGBA(directRenderer(), x, y, numPts, r, g, b, a);
 		}
 		void polygon(uint8_t numPts, const int16_t* x, const int16_t* y, uint32_t color = 0xFFFFFFFF) {
-			if(antiAlias) aapolygonRGBA(renderer, x, y, numPts, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
-			else polygonRGBA(renderer, x, y, numPts, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			if(antiAlias) aapolygonRGBA(directRenderer(), x, y, numPts, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			else polygonRGBA(directRenderer(), x, y, numPts, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 		void fillPolygon(uint8_t numPts, const int16_t* x, const int16_t* y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
-			filledPolygonRGBA(renderer, x, y, numPts, r, g, b, a);
+			filledPolygonRGBA(directRenderer(), x, y, numPts, r, g, b, a);
 		}
 		void fillPolygon(uint8_t numPts, const int16_t* x, const int16_t* y, uint32_t color = 0xFFFFFFFF) {
-			filledPolygonRGBA(renderer, x, y, numPts, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
+			filledPolygonRGBA(directRenderer(), x, y, numPts, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 		}
 	#endif
 	#ifdef ARGON_INCLUDE_TTF
@@ -481,11 +1779,32 @@ public:
 				return TTF_OpenFont(fontFile, fontSize);
 			}
 			void freeFont(Font* font) {
+				freeGlyphAtlas(font);
 				if(font != NULL) TTF_CloseFont(font);
 			}
+			void setGlyphAtlas(bool val) {glyphAtlasEnabled = val;}
 			void string(const char* txt, Font* font, int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+				if(glyphAtlasEnabled) {
+					// Glyphs come from the font's atlas and are queued as quads, consecutive strings share one draw call
+					if(font == NULL || txt == NULL) {return;}
+					GlyphAtlas& glyphs = glyphAtlas(font);
+					if(!commands.empty()) {flushCommands();}
+					SDL_Color color = {r, g, b, a};
+					int32_t pen = x;
+					for(const uint8_t* c = (const uint8_t*)txt; *c != 0; ++c) {
+						if(c != (const uint8_t*)txt) {pen += glyphKerning(glyphs, font, c[-1], c[0]);}
+						const Glyph& glyph = cacheGlyph(glyphs, font, *c);
+						if(glyph.rect.w > 0) {
+							const float x0 = pen, y0 = y, x1 = pen + glyph.rect.w, y1 = y + glyph.rect.h;
+							const SDL_FPoint corners[4] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+							queueQuad(glyphs.atlas.pages[glyph.page], glyph.rect, corners, color);
+						}
+						pen += glyph.advance;
+					}
+					return;
+				}
 				SDL_Surface* surface = TTF_RenderText_Blended(font, txt, {r, g, b, a});
-				SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+				SDL_Texture* texture = SDL_CreateTextureFromSurface(directRenderer(), surface);
 				int texW = 0;
 				int texH = 0;
 				SDL_QueryTexture(texture, NULL, NULL, &texW, &texH);
@@ -498,19 +1817,152 @@ public:
 				string(txt, font, x, y, (uint8_t)(color>>24), (uint8_t)(color>>16), (uint8_t)(color>>8), (uint8_t)color);
 			}
 			void stringDimensions(const char* string, Font* font, int* w, int* h) {
-				TTF_SizeText(font, string, w, h);
+				if(!glyphAtlasEnabled || font == NULL || string == NULL) {
+					TTF_SizeText(font, string, w, h);
+					return;
+				}
+				// Measured from the cached metrics, matches what string() draws
+				GlyphAtlas& glyphs = glyphAtlas(font);
+				int32_t pen = 0, right = 0;
+				for(const uint8_t* c = (const uint8_t*)string; *c != 0; ++c) {
+					if(c != (const uint8_t*)string) {pen += glyphKerning(glyphs, font, c[-1], c[0]);}
+					const Glyph& glyph = cacheGlyph(glyphs, font, *c);
+					right = std::max(right, pen + std::max<int32_t>(glyph.rect.w, glyph.advance));
+					pen += glyph.advance;
+				}
+				*w = right;
+				*h = glyphs.height;
 			}
 	#endif
 
 private:
 	const char* title;
-	SDL_Window* window;
-	SDL_Renderer* renderer;
+	SDL_Window* window = NULL;
+	SDL_Renderer* renderer = NULL;
+	SDL_Surface* surface = NULL; // Offscreen render target in headless mode
 	bool running = false;
 	bool vsyncEnabled = false;
+	uint64_t frames = 0;
+	uint64_t maxFrames = 0;
 
-	// Window Data
-	uint16_t _wx;
+	static bool envFlag(const char* name) {
+		// Unset, empty and "0" are off, so ARGON_HEADLESS=0 doesn't turn headless mode on
+		const char* value = getenv(name);
+		return value != NULL && value[0] != '\0' && strcmp(value, "0") != 0;
+	}
+
+	// Profiler
+	enum ProfilePhaseId : uint8_t {PHASE_FRAME, PHASE_EVENTS, PHASE_GAME_LOOP, PHASE_TEXTURE, PHASE_FLUSH, PHASE_WAIT, PHASE_PRESENT, PHASE_CAPTURE};
+	struct ProfilePhase {
+		std::string name; // Owned, scope names may be temporaries
+		uint64_t frameTotal;
+		std::vector<float> history;
+		uint32_t frames; // Frames recorded since the phase was created, at most ARGON_PROFILE_FRAMES
+	};
+	bool profiling = false;
+	bool profilerOverlay = false;
+	std::vector<ProfilePhase> profilePhases;
+	std::vector<std::pair<uint8_t, uint64_t>> profileScopes;
+	std::vector<float> profileScratch;
+	uint32_t profileIndex = 0;
+	uint32_t profileFrames = 0;
+
+	inline uint64_t profileNow() {return profiling ? SDL_GetPerformanceCounter() : 0;}
+	inline uint64_t profileEnd(uint8_t phase, uint64_t start) {
+		if(!profiling || start == 0) {return profileNow();}
+		uint64_t now = SDL_GetPerformanceCounter();
+		profilePhases[phase].frameTotal += now - start;
+		return now;
+	}
+	int32_t findProfilePhase(const char* name) {
+		for(uint8_t i = 0; i < profilePhases.size(); ++i) {
+			if(profilePhases[i].name == name) {return i;}
+		}
+		return -1;
+	}
+	uint8_t profilePhase(const char* name) {
+		// Creates the phase the first time a name is used
+		int32_t found = findProfilePhase(name);
+		if(found >= 0) {return found;}
+		if(profilePhases.size() == 255) {return PHASE_GAME_LOOP;}
+		profilePhases.push_back({name, 0, std::vector<float>(ARGON_PROFILE_FRAMES, 0.0f), 0});
+		return profilePhases.size() - 1;
+	}
+	void commitProfileFrame() {
+		const double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+		for(ProfilePhase& phase : profilePhases) {
+			phase.history[profileIndex] = phase.frameTotal * toMs;
+			phase.frameTotal = 0;
+			if(phase.frames < ARGON_PROFILE_FRAMES) {++phase.frames;}
+		}
+		profileIndex = (profileIndex + 1) % ARGON_PROFILE_FRAMES;
+		if(profileFrames < ARGON_PROFILE_FRAMES) {++profileFrames;}
+	}
+	void drawProfilerOverlay() {
+		// Frame graph: one column per frame, phases stacked bottom to top, with a line at the target frame time
+		static constexpr uint8_t stacked[] = {PHASE_EVENTS, PHASE_GAME_LOOP, PHASE_FLUSH, PHASE_WAIT, PHASE_CAPTURE, PHASE_PRESENT};
+		static constexpr uint32_t colors[] = {0x3C8CFFFF, 0x3CDC5AFF, 0xFFD23CFF, 0x808080FF, 0xC85AFFFF, 0xFF5A3CFF};
+		static constexpr float pxPerMs = 4;
+		static constexpr int32_t graphH = 100, x0 = 4, y0 = 4, histX = x0 + ARGON_PROFILE_FRAMES + 8;
+		const double targetMs = targetFps > 0 ? 1000.0 / targetFps : 1000.0 / 60.0;
+		std::vector<uint32_t> histogram = getFrameHistogram(1.0, 34);
+		uint32_t histMax = 1;
+		for(uint32_t count : histogram) {histMax = count > histMax ? count : histMax;}
+
+		beginRects();
+		addRect(x0 - 2, y0 - 2, histX + histogram.size() * 3 - x0 + 4, graphH + 4, 0x000000B4);
+		for(uint32_t i = 0; i < profileFrames; ++i) {
+			uint32_t frame = (profileIndex + ARGON_PROFILE_FRAMES - profileFrames + i) % ARGON_PROFILE_FRAMES;
+			float y = y0 + graphH;
+			for(uint8_t p = 0; p < sizeof(stacked); ++p) {
+				float h = profilePhases[stacked[p]].history[frame] * pxPerMs;
+				if(y - h < y0) {h = y - y0;}
+				if(h >= 1) {addRect(x0 + i, y - h, 1, h, colors[p]);}
+				y -= h;
+			}
+		}
+		addRect(x0, y0 + graphH - targetMs * pxPerMs, ARGON_PROFILE_FRAMES, 1, 0xFFFFFFFF);
+		for(uint32_t i = 0; i < histogram.size(); ++i) {
+			uint16_t h = histogram[i] * graphH / histMax;
+			if(h > 0) {addRect(histX + i * 3, y0 + graphH - h, 2, h, 0xFFFFFFC8);}
+		}
+		endRects();
+	}
+
+	// Frame Limiter (counter values are in SDL performance counter ticks)
+	double targetFps = 0;
+	uint64_t nextFrameDeadline = 0;
+	uint64_t lastFrameStart = 0;
+	uint64_t sleepMargin = 0;
+	struct {
+		uint32_t frames = 0;
+		uint32_t missed = 0;
+		uint32_t intervals = 0;
+		uint64_t maxError = 0;
+		double error = 0;
+		double sleep = 0;
+		double spin = 0;
+		double interval = 0;
+		double interval2 = 0;
+	} pacing;
+
+	// On Demand Rendering
+	bool onDemand = false;
+	bool minimized = false;
+	std::atomic<bool> redrawRequested{false};
+	std::atomic<bool> waitingForEvents{false};
+	uint32_t wakeEvent = 0;
+	std::atomic<uint32_t> redrawAt{0};
+	int32_t logicalW = -1;
+	int32_t logicalH = -1;
+
+	// Fixed Timestep
+	double fixedStep = 0;
+	double stepAccumulator = 0;
+	uint16_t maxSteps = 8;
+
+	// Window Data
+	uint16_t _wx;
 	uint16_t _wy;
 	uint16_t _ww;
 	uint16_t _wh;
@@ -520,6 +1972,58 @@ private:
 	uint16_t _my;
 	uint8_t _mwhich;
 	bool down = false;
+	InputState input{};
+	bool coalesceMotion = false;
+	bool motionPending = false;
+	uint32_t motionTimestamp = 0;
+	int32_t motionRx = 0;
+	int32_t motionRy = 0;
+
+	// Input Recording, a header followed by the handled events of every frame and then its deltaTime
+	enum RecordTag : uint8_t {REC_FRAME, REC_QUIT, REC_MOUSE_DOWN, REC_MOUSE_UP, REC_MOTION, REC_WHEEL, REC_KEY_DOWN, REC_KEY_UP, REC_WINDOW};
+	static constexpr uint8_t RECORD_VERSION = 1;
+	FILE* recordFile = NULL;
+	std::vector<uint8_t> recordBuffer;
+	std::vector<uint8_t> replayData;
+	size_t replayPos = 0;
+	bool replaying = false;
+	bool replayRealtime = true;
+	double replayDt = 0;
+	double replayClock = 0;
+	uint64_t replayStart = 0;
+
+	// Frame Capture, buffers go from free to the main thread (readback) to queue to the encoder thread and back to free
+	struct CaptureFrame {
+		std::vector<uint8_t> pixels; // RGBA
+		uint32_t repeat; // 1 + frames dropped right before this one, so the file keeps the timing of the app
+	};
+	struct {
+		FILE* file = NULL;
+		CaptureFormat format = CAPTURE_GIF;
+		CapturePolicy policy = CAPTURE_DROP;
+		int32_t w = 0;
+		int32_t h = 0;
+		uint16_t fps = 60;
+		CaptureStats stats = {0, 0};
+		uint32_t skipped = 0;
+		std::vector<CaptureFrame> pool;
+		std::vector<CaptureFrame*> free; // Guarded by mutex from here on
+		std::deque<CaptureFrame*> queue;
+		bool quit = false;
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::thread thread;
+		uint64_t time = 0; // Encoder state from here on, frames encoded so far counting repeats
+		std::vector<uint8_t> previous; // Last frame written to a GIF
+		std::vector<uint8_t> pending; // Encoded GIF frame held back until its delay is final
+		uint32_t pendingDelay = 0;
+		std::vector<uint32_t> histogram;
+		std::vector<uint16_t> colors;
+		std::vector<uint8_t> indices;
+		std::vector<int32_t> lzwKeys;
+		std::vector<uint16_t> lzwCodes;
+		std::vector<uint8_t> out;
+	} capture;
 
 
 	// Flags
@@ -533,11 +2037,501 @@ private:
 		uint8_t a = 255;
 	} background;
 
-	std::vector<Texture> textures;
+	// Texture Registry, a deque never moves its elements so the Texture* handed out stays valid
+	struct TextureSlot {
+		Texture texture;
+		uint32_t generation; // Bumped when the texture is destroyed so old handles stop resolving
+		uint32_t index;
+		bool live;
+	};
+	std::deque<TextureSlot> textureSlots;
+	std::vector<uint32_t> freeTextureSlots;
+	std::unordered_map<SDL_Texture*, std::vector<uint8_t>> shadowBuffers;
+
+	// Layers, sorted by order with equal orders kept in creation order
+	std::vector<std::unique_ptr<Layer>> layers;
+	int32_t layersDrawnTo = INT32_MIN; // Highest order composited onto the screen since it was last cleared
+
+	// Render Targets, the screen's output size is kept while drawing into a texture since SDL reports the texture's instead
+	SDL_Texture* renderTarget = NULL;
+	int32_t targetOutputW = 0;
+	int32_t targetOutputH = 0;
+
+	// Texture Resizing, w & h are the visible size (POW2 textures are allocated larger)
+	struct TextureInfo {
+		TextureResize resize;
+		bool preserve;
+		int32_t w;
+		int32_t h;
+		bool locked; // A preserved texture handed out its CPU copy in lockTexture
+		uint32_t slot;
+		uint32_t format; // SDL_PIXELFORMAT_RGBA32 or SDL_PIXELFORMAT_BGRA32
+		SDL_TextureAccess access;
+	};
+	std::unordered_map<SDL_Texture*, TextureInfo> textureInfo;
+	std::vector<std::pair<uint64_t, SDL_Texture*>> texturePool; // Oldest first, keyed by (w << 32 | h), format and access are checked on reuse
+	uint32_t nativeFormat = SDL_PIXELFORMAT_UNKNOWN; // Picked on first use, see getNativeFormat
+	uint32_t resizeDebounce = ARGON_RESIZE_DEBOUNCE;
+	uint32_t resizeAt = 0;
+	bool resizePending = false;
+
+	TextureSlot* findTextureSlot(Texture* texture) {
+		// Live textures are found through their info, only textures that failed to be created need a scan
+		if(texture == NULL) {return NULL;}
+		if(*texture != NULL) {
+			auto info = textureInfo.find(*texture);
+			return info != textureInfo.end() ? &textureSlots[info->second.slot] : NULL;
+		}
+		for(auto& slot : textureSlots) {
+			if(slot.live && &slot.texture == texture) {return &slot;}
+		}
+		return NULL;
+	}
+	void freeTextureSlot(TextureSlot& slot) {
+		slot.texture = NULL;
+		slot.live = false;
+		if(++slot.generation == 0) {slot.generation = 1;}
+		freeTextureSlots.push_back(slot.index);
+	}
+	static int32_t nextPow2(int32_t v) {
+		int32_t p = 1;
+		while(p < v) {p <<= 1;}
+		return p;
+	}
+	bool textureSize(SDL_Texture* texture, int32_t* w, int32_t* h) {
+		if(texture == NULL) {return false;}
+		auto info = textureInfo.find(texture);
+		if(info == textureInfo.end()) {return SDL_QueryTexture(texture, NULL, NULL, w, h) == 0;}
+		*w = info->second.w;
+		*h = info->second.h;
+		return true;
+	}
+	SDL_Texture* allocTexture(int32_t w, int32_t h, uint32_t format = SDL_PIXELFORMAT_RGBA32, SDL_TextureAccess access = SDL_TEXTUREACCESS_STREAMING) {
+		uint64_t key = ((uint64_t)w << 32) | (uint32_t)h;
+		for(size_t i = texturePool.size(); i-- > 0;) {
+			uint32_t pooledFormat;
+			int pooledAccess;
+			if(texturePool[i].first == key && SDL_QueryTexture(texturePool[i].second, &pooledFormat, &pooledAccess, NULL, NULL) == 0 && pooledFormat == format && pooledAccess == access) {
+				SDL_Texture* texture = texturePool[i].second;
+				texturePool.erase(texturePool.begin() + i);
+				return texture;
+			}
+		}
+		return SDL_CreateTexture(renderer, format, access, w, h);
+	}
+	uint32_t sdlFormat(TextureFormat format) {
+		if(format == TEXTURE_NATIVE) {return getNativeFormat();}
+		return format == TEXTURE_BGRA ? SDL_PIXELFORMAT_BGRA32 : SDL_PIXELFORMAT_RGBA32;
+	}
+	uint32_t textureFormat(SDL_Texture* texture) {
+		auto info = textureInfo.find(texture);
+		return info != textureInfo.end() ? info->second.format : (uint32_t)SDL_PIXELFORMAT_RGBA32;
+	}
+	Framebuffer lockPixels(Texture* texture) {
+		// lockTexture as a Framebuffer in the texture's channel order
+		Framebuffer fb = {NULL, 0, 0, 0, {0, 0, 0, 0}};
+		fb.pixels = lockTexture(texture, &fb.w, &fb.h, &fb.pitch);
+		fb.format = textureFormat(*texture);
+		return fb;
+	}
+	void releaseTexture(SDL_Texture* texture) {
+		int32_t w, h;
+		if(texture == NULL) {return;}
+		if(ARGON_TEXTURE_POOL_SIZE == 0 || SDL_QueryTexture(texture, NULL, NULL, &w, &h) != 0) {
+			SDL_DestroyTexture(texture);
+			return;
+		}
+		// Reset state the app may have changed so a reused texture looks freshly created
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+		SDL_SetTextureColorMod(texture, 255, 255, 255);
+		SDL_SetTextureAlphaMod(texture, 255);
+		if(texturePool.size() >= ARGON_TEXTURE_POOL_SIZE) {
+			SDL_DestroyTexture(texturePool.front().second);
+			texturePool.erase(texturePool.begin());
+		}
+		texturePool.push_back({((uint64_t)w << 32) | (uint32_t)h, texture});
+	}
+	static void resizePixels(std::vector<uint8_t>& pixels, int32_t w, int32_t h, int32_t newW, int32_t newH, uint8_t bytesPerPixel) {
+		// Keeps the top left part that fits, new pixels are zero
+		std::vector<uint8_t> resized((size_t)newW * newH * bytesPerPixel, 0);
+		if(pixels.size() == (size_t)w * h * bytesPerPixel) {
+			for(int32_t y = 0; y < std::min(h, newH); ++y) {
+				memcpy(&resized[(size_t)y * newW * bytesPerPixel], &pixels[(size_t)y * w * bytesPerPixel], (size_t)std::min(w, newW) * bytesPerPixel);
+			}
+		}
+		pixels.swap(resized);
+	}
+
+	// Palette Indexed Textures, the palette is stored as pixel values in the texture's channel order
+	struct IndexedTexture {
+		std::vector<uint8_t> indices;
+		uint32_t palette[256];
+	};
+	std::unordered_map<SDL_Texture*, IndexedTexture> indexedTextures;
+
+	IndexedTexture& indexedTexture(SDL_Texture* texture) {
+		auto entry = indexedTextures.try_emplace(texture);
+		if(entry.second) {
+			for(uint16_t i = 0; i < 256; ++i) {entry.first->second.palette[i] = pixelValue(packColor(i, i, i, 255), textureFormat(texture));}
+		}
+		return entry.first->second;
+	}
+	void uploadIndexed(SDL_Texture* texture, IndexedTexture& indexed, int32_t w, SDL_Rect rect) {
+		// Expand the palette indices straight into the locked texture, large regions are split across the job system
+		uint8_t* dst;
+		int32_t pitch;
+		uint64_t start = profileNow();
+		if(SDL_LockTexture(texture, &rect, reinterpret_cast<void**>(&dst), &pitch) == 0) {
+			const uint8_t* src = indexed.indices.data() + (size_t)rect.y * w + rect.x;
+			const uint32_t* palette = indexed.palette;
+			parallelFor(0, rect.h, [&](int32_t y) {
+				pixelKernels().expand(reinterpret_cast<uint32_t*>(dst + (size_t)y * pitch), src + (size_t)y * w, palette, rect.w);
+			}, 32);
+			SDL_UnlockTexture(texture);
+		}
+		profileEnd(PHASE_TEXTURE, start);
+	}
+
+	// Async Framebuffer, the worker fills the back buffer while the main thread keeps running frames with the last uploaded front buffer
+	// A finished fill becomes the front buffer and is uploaded at the start of the next frame, the main thread never waits for a fill
+	struct {
+		Texture* texture = NULL;
+		std::vector<uint8_t> buffers[2];
+		Framebuffer fb = {NULL, 0, 0, 0, {0, 0, 0, 0}}; // The fill in buffers[front ^ 1]
+		uint8_t front = 0;
+		SDL_Rect frontDirty = {0, 0, 0, 0}; // What the front buffer's fill changed, copied into the back buffer before the next fill
+		int32_t frontW = 0;
+		bool requested = false;
+		bool filling = false; // Guarded by mutex from here on
+		bool filled = false; // A finished fill waits in the back buffer to be uploaded
+		bool quit = false;
+		uint64_t fillTicks = 0;
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::thread thread;
+	} asyncPixels;
+
+	// Job System, every worker owns a deque, it pops its own newest job and steals the oldest job of others when empty
+	struct alignas(64) JobQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+	struct {
+		std::vector<std::thread> threads;
+		std::vector<std::unique_ptr<JobQueue>> queues; // One per worker, the last one is shared by all other threads
+		std::atomic<uint32_t> queued{0};
+		std::atomic<uint32_t> unfinished{0};
+		uint32_t cores = 1;
+		std::atomic<bool> started{false};
+		bool quit = false;
+		std::mutex mutex;
+		std::mutex startMutex;
+		std::condition_variable wake;
+		std::condition_variable finished; // Threads in helpUntil with nothing to run wait here
+		std::atomic<uint32_t> helpersWaiting{0};
+	} jobs;
+
+	static int32_t& jobQueueIndex() {
+		static thread_local int32_t index = -1;
+		return index;
+	}
+	JobQueue& localJobQueue() {
+		int32_t index = jobQueueIndex();
+		return *jobs.queues[index >= 0 ? index : jobs.queues.size() - 1];
+	}
+	void startJobWorkers() {
+		// Sized to the machine, with at least one worker so jobs run even if nobody waits for them
+		std::lock_guard<std::mutex> lock(jobs.startMutex);
+		if(jobs.started) {return;}
+		jobs.cores = std::max(1, SDL_GetCPUCount());
+		const uint32_t n = std::max<uint32_t>(1, jobs.cores - 1);
+		for(uint32_t i = 0; i <= n; ++i) {jobs.queues.emplace_back(new JobQueue());}
+		jobs.quit = false;
+		jobs.threads.reserve(n);
+		for(uint32_t i = 0; i < n; ++i) {jobs.threads.emplace_back(&Argon::jobWorker, this, i);}
+		jobs.started = true;
+	}
+	void stopJobWorkers() {
+		{
+			std::lock_guard<std::mutex> lock(jobs.mutex);
+			jobs.quit = true;
+		}
+		jobs.wake.notify_all();
+		for(std::thread& thread : jobs.threads) {thread.join();}
+		jobs.threads.clear();
+		jobs.queues.clear();
+		jobs.started = false;
+	}
+	void pushJob(const Job& job) {
+		JobQueue& queue = localJobQueue();
+		++jobs.queued;
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(job);
+		}
+		{std::lock_guard<std::mutex> lock(jobs.mutex);} // Don't let a worker miss the wake up between its check and its wait
+		jobs.wake.notify_one();
+		notifyJobHelpers();
+	}
+	void notifyJobHelpers() {
+		// Locking first means a helper that counted itself as waiting is already asleep
+		if(jobs.helpersWaiting == 0) {return;}
+		{std::lock_guard<std::mutex> lock(jobs.mutex);}
+		jobs.finished.notify_all();
+	}
+	Job popJob() {
+		JobQueue& own = localJobQueue();
+		{
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if(!own.jobs.empty()) {
+				Job job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				--jobs.queued;
+				return job;
+			}
+		}
+		const uint32_t n = jobs.queues.size();
+		const uint32_t start = jobQueueIndex() >= 0 ? jobQueueIndex() : 0;
+		for(uint32_t k = 1; k <= n; ++k) {
+			JobQueue& other = *jobs.queues[(start + k) % n];
+			if(&other == &own) {continue;}
+			std::lock_guard<std::mutex> lock(other.mutex);
+			if(!other.jobs.empty()) {
+				Job job = std::move(other.jobs.front());
+				other.jobs.pop_front();
+				--jobs.queued;
+				return job;
+			}
+		}
+		return Job();
+	}
+	bool runOneJob() {
+		Job job = popJob();
+		if(!job) {return false;}
+		job->task();
+		std::vector<Job> next;
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->done = true;
+			next.swap(job->next);
+		}
+		for(Job& dependent : next) {
+			if(--dependent->waitingFor == 0) {pushJob(dependent);}
+		}
+		if(job->group != NULL) {--*job->group;}
+		--jobs.unfinished;
+		notifyJobHelpers();
+		return true;
+	}
+	void jobWorker(uint32_t index) {
+		jobQueueIndex() = index;
+		while(true) {
+			if(runOneJob()) {continue;}
+			std::unique_lock<std::mutex> lock(jobs.mutex);
+			jobs.wake.wait(lock, [this] {return jobs.quit || jobs.queued > 0;});
+			if(jobs.quit) {return;}
+		}
+	}
+	Job submitJob(std::function<void()> task, std::atomic<uint32_t>* group, const Job* dependencies, size_t count) {
+		if(!jobs.started) {startJobWorkers();}
+		Job job = std::make_shared<JobState>();
+		job->task = std::move(task);
+		job->group = group;
+		++jobs.unfinished;
+		for(size_t i = 0; i < count; ++i) {
+			const Job& dependency = dependencies[i];
+			if(!dependency) {continue;}
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if(!dependency->done) {
+				dependency->next.push_back(job);
+				++job->waitingFor;
+			}
+		}
+		if(--job->waitingFor == 0) {pushJob(job);}
+		return job;
+	}
+	void helpUntil(const std::function<bool()>& finished) {
+		// Run other jobs while waiting so waiting from inside a job can't deadlock, sleep when there are none
+		while(!finished()) {
+			if(runOneJob()) {continue;}
+			std::unique_lock<std::mutex> lock(jobs.mutex);
+			++jobs.helpersWaiting;
+			jobs.finished.wait(lock, [&] {return jobs.queued > 0 || finished();});
+			--jobs.helpersWaiting;
+		}
+	}
+
+	void startPixels() {
+		// Only one fill runs at a time, a request made while the worker is busy starts after a later gameLoop
+		{
+			std::lock_guard<std::mutex> lock(asyncPixels.mutex);
+			if(asyncPixels.filling) {return;}
+		}
+		syncPixels(true); // A fill that finished during this frame becomes the front buffer first
+		asyncPixels.requested = false;
+
+		// Size the back buffer on the main thread, the texture may have been recreated since the last fill (which clears it)
+		Framebuffer& fb = asyncPixels.fb;
+		fb = {NULL, 0, 0, 0, {0, 0, 0, 0}};
+		if(!textureSize(*asyncPixels.texture, &fb.w, &fb.h)) {return;}
+		fb.pitch = fb.w * 4;
+		fb.format = textureFormat(*asyncPixels.texture);
+		std::vector<uint8_t>& buffer = asyncPixels.buffers[asyncPixels.front ^ 1];
+		if(buffer.size() != (size_t)fb.pitch * fb.h) {buffer.assign((size_t)fb.pitch * fb.h, 0);}
+		fb.pixels = buffer.data();
+		preparePixels();
+		{
+			std::lock_guard<std::mutex> lock(asyncPixels.mutex);
+			asyncPixels.filling = true;
+		}
+		asyncPixels.cv.notify_all();
+	}
+	void syncPixels(bool upload) {
+		// Swap a finished fill to the front and upload it without waiting, when stopping wait for the worker and drop its fill
+		{
+			std::unique_lock<std::mutex> lock(asyncPixels.mutex);
+			if(!upload) {asyncPixels.cv.wait(lock, [this] {return !asyncPixels.filling;});}
+			if(!asyncPixels.filled) {return;}
+			asyncPixels.filled = false;
+		}
+		Framebuffer& fb = asyncPixels.fb;
+		if(upload) {
+			const SDL_Rect bounds = {0, 0, fb.w, fb.h};
+			if(!SDL_IntersectRect(&fb.dirty, &bounds, &fb.dirty)) {fb.dirty = {0, 0, 0, 0};}
+			asyncPixels.front ^= 1;
+			asyncPixels.frontDirty = fb.dirty;
+			asyncPixels.frontW = fb.w;
+			int32_t w = 0, h = 0;
+			uint64_t start = profileNow();
+			if(fb.isDirty() && textureSize(*asyncPixels.texture, &w, &h) && w == fb.w && h == fb.h) {
+				SDL_UpdateTexture(*asyncPixels.texture, &fb.dirty, fb.at(fb.dirty.x, fb.dirty.y), fb.pitch);
+			}
+			profileEnd(PHASE_TEXTURE, start);
+			if(profiling) {profilePhases[profilePhase("fillPixels")].frameTotal += asyncPixels.fillTicks;}
+		}
+		fb.pixels = NULL;
+	}
+	void pixelWorker() {
+		std::unique_lock<std::mutex> lock(asyncPixels.mutex);
+		while(true) {
+			asyncPixels.cv.wait(lock, [this] {return asyncPixels.filling || asyncPixels.quit;});
+			if(asyncPixels.quit) {return;}
+			lock.unlock();
+			uint64_t start = SDL_GetPerformanceCounter();
+			Framebuffer& fb = asyncPixels.fb;
+			// The back buffer is one fill behind, bring over what the front buffer's fill changed so unwritten pixels keep their last value
+			const std::vector<uint8_t>& front = asyncPixels.buffers[asyncPixels.front];
+			const SDL_Rect& changed = asyncPixels.frontDirty;
+			if(asyncPixels.frontW == fb.w && front.size() == (size_t)fb.pitch * fb.h && changed.w > 0 && changed.h > 0) {
+				for(int32_t y = changed.y; y < changed.y + changed.h; ++y) {
+					memcpy(fb.at(changed.x, y), &front[(size_t)y * fb.pitch + changed.x * 4], (size_t)changed.w * 4);
+				}
+			}
+			fb.markAllDirty();
+			fillPixels(fb);
+			uint64_t ticks = SDL_GetPerformanceCounter() - start;
+			lock.lock();
+			asyncPixels.fillTicks = ticks;
+			asyncPixels.filling = false;
+			asyncPixels.filled = true;
+			asyncPixels.cv.notify_all();
+			lock.unlock();
+			requestRedraw(); // Show the new pixels in on demand mode
+			lock.lock();
+		}
+	}
 	bool antiAlias = false;
 
+	void wakeGameLoop() {
+		// Unblock the game loop if it's waiting for events (safe to call from other threads)
+		if(waitingForEvents) {
+			SDL_Event wake = {};
+			wake.type = wakeEvent;
+			SDL_PushEvent(&wake);
+		}
+	}
+	bool waitForRedraw(SDL_Event& event) {
+		// The flag is set before checking for requests, so a requestRedraw from another thread is either seen here or pushes a wake event
+		waitingForEvents = true;
+		const bool requested = redrawRequested.exchange(false);
+		const uint32_t now = SDL_GetTicks();
+		uint32_t at = redrawAt;
+		const bool due = at != 0 && now >= at;
+		if(!minimized && (requested || due)) {
+			if(due) {redrawAt.compare_exchange_strong(at, 0);}
+			waitingForEvents = false;
+			return true;
+		}
+
+		// Nothing to draw, sleep until an event arrives or a scheduled redraw is due (never wake for timers while minimized)
+		int got = (at != 0 && !minimized) ? SDL_WaitEventTimeout(&event, at - now) : SDL_WaitEventTimeout(&event, -1);
+		waitingForEvents = false;
+		if(got) {
+			handleEvent(event);
+			if(event.type == wakeEvent && !redrawRequested.exchange(false)) {return false;}
+			return !minimized || !running;
+		}
+		return false;
+	}
+	void limitFrameRate() {
+		const uint64_t freq = SDL_GetPerformanceFrequency();
+		const uint64_t period = freq / targetFps;
+		uint64_t now = SDL_GetPerformanceCounter();
+		if(nextFrameDeadline == 0) {nextFrameDeadline = now + period;}
+		if(sleepMargin == 0) {sleepMargin = freq * 3 / 2000;}
+		const uint64_t start = now;
+		const bool late = now > nextFrameDeadline;
+
+		// Sleep in 1ms steps while the deadline is further away than the longest SDL_Delay(1) we have seen
+		while(now < nextFrameDeadline && nextFrameDeadline - now > sleepMargin) {
+			SDL_Delay(1);
+			uint64_t after = SDL_GetPerformanceCounter();
+			uint64_t slept = after - now;
+			sleepMargin = slept > sleepMargin ? slept : sleepMargin - (sleepMargin - slept) / 64;
+			now = after;
+		}
+		const uint64_t slept = now - start;
+
+		// Spin for the remaining fraction of a millisecond
+		while(now < nextFrameDeadline) {now = SDL_GetPerformanceCounter();}
+
+		uint64_t error = now - nextFrameDeadline;
+		++pacing.frames;
+		pacing.missed += late;
+		pacing.error += error;
+		pacing.maxError = error > pacing.maxError ? error : pacing.maxError;
+		pacing.sleep += slept;
+		pacing.spin += now - start - slept;
+		if(lastFrameStart != 0) {
+			double interval = now - lastFrameStart;
+			++pacing.intervals;
+			pacing.interval += interval;
+			pacing.interval2 += interval * interval;
+		}
+		lastFrameStart = now;
+
+		// Schedule next deadline, if we fell behind start over instead of rushing to catch up
+		nextFrameDeadline += period;
+		if(nextFrameDeadline <= now) {nextFrameDeadline = now + period;}
+	}
+	void runFixedSteps(double dt) {
+		stepAccumulator += dt;
+		uint16_t steps = 0;
+		while(stepAccumulator >= fixedStep && steps < maxSteps) {
+			simulate(fixedStep);
+			stepAccumulator -= fixedStep;
+			++steps;
+		}
+		// Drop time we can't catch up on instead of falling further behind every frame
+		if(stepAccumulator >= fixedStep) {stepAccumulator = fmod(stepAccumulator, fixedStep);}
+		render(stepAccumulator / fixedStep);
+	}
+
 	// Event System
 	void handleEvent(SDL_Event& event) {
+		if(recordFile != NULL) {recordEvent(event);}
+		// Merged motion goes out before the next other event so handlers still see events in order
+		if(motionPending && event.type != SDL_MOUSEMOTION) {flushMotion();}
 		switch(event.type) {
 			case SDL_QUIT: {
 				onQuit({event.quit.timestamp});
@@ -547,35 +2541,61 @@ private:
 			case SDL_MOUSEBUTTONDOWN: {
 				down = true;
 				_mwhich = event.button.button;
+				input.buttons |= SDL_BUTTON(event.button.button);
+				input.buttonsPressed |= SDL_BUTTON(event.button.button);
 				onMouseDown({{event.button.timestamp}, _mx, _my, event.button.button, event.button.clicks});
 				break;
 			}
 			case SDL_MOUSEBUTTONUP: {
 				down = false;
+				input.buttons &= ~SDL_BUTTON(event.button.button);
+				input.buttonsReleased |= SDL_BUTTON(event.button.button);
 				onMouseUp({{event.button.timestamp}, _mx, _my, event.button.button, event.button.clicks});
 				break;
 			}
 			case SDL_MOUSEMOTION: {
 				_mx = static_cast<uint16_t>(event.motion.x);
 				_my = static_cast<uint16_t>(event.motion.y);
+				input.x = _mx;
+				input.y = _my;
+				input.rx += event.motion.xrel;
+				input.ry += event.motion.yrel;
+				if(coalesceMotion) {
+					if(!motionPending) {motionRx = motionRy = 0;}
+					motionPending = true;
+					motionTimestamp = event.motion.timestamp;
+					motionRx += event.motion.xrel;
+					motionRy += event.motion.yrel;
+					break;
+				}
 				onMouseMove({{event.motion.timestamp}, _mx, _my, static_cast<int16_t>(event.motion.xrel), static_cast<int16_t>(event.motion.yrel), down});
 				break;
 			}
 			case SDL_MOUSEWHEEL: {
+				const int32_t flip = event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -1 : 1;
+				input.wheelX += event.wheel.x * flip;
+				input.wheelY += event.wheel.y * flip;
 				onMouseWheel({{event.wheel.timestamp}, event.wheel.x, event.wheel.y, down, event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED});
 				break;
 			}
 			case SDL_KEYDOWN: {
+				if(!event.key.repeat) {
+					input.keys[event.key.keysym.scancode] = true;
+					input.pressed[event.key.keysym.scancode] = true;
+				}
 				onKeyDown({{event.key.timestamp},event.key.keysym.scancode,event.key.keysym.sym,event.key.repeat > 0,{!static_cast<bool>((event.key.keysym.mod & KMOD_SHIFT) || (event.key.keysym.mod & KMOD_ALT) || (event.key.keysym.mod & KMOD_CTRL) || (event.key.keysym.mod & KMOD_GUI) || (event.key.keysym.mod & KMOD_CAPS) || (event.key.keysym.mod & KMOD_NUM) || (event.key.keysym.mod & KMOD_MODE)),static_cast<bool>(event.key.keysym.mod & KMOD_SHIFT),static_cast<bool>(event.key.keysym.mod & KMOD_LSHIFT),static_cast<bool>(event.key.keysym.mod & KMOD_RSHIFT),static_cast<bool>(event.key.keysym.mod & KMOD_CTRL),static_cast<bool>(event.key.keysym.mod & KMOD_LCTRL),static_cast<bool>(event.key.keysym.mod & KMOD_RCTRL),static_cast<bool>(event.key.keysym.mod & KMOD_ALT),static_cast<bool>(event.key.keysym.mod & KMOD_LALT),static_cast<bool>(event.key.keysym.mod & KMOD_RALT),static_cast<bool>(event.key.keysym.mod & KMOD_GUI),static_cast<bool>(event.key.keysym.mod & KMOD_LGUI),static_cast<bool>(event.key.keysym.mod & KMOD_RGUI),static_cast<bool>(event.key.keysym.mod & KMOD_CAPS),static_cast<bool>(event.key.keysym.mod & KMOD_NUM),static_cast<bool>(event.key.keysym.mod & KMOD_MODE)}});
 				break;
 			}
 			case SDL_KEYUP: {
+				input.keys[event.key.keysym.scancode] = false;
+				input.released[event.key.keysym.scancode] = true;
 				onKeyUp({{event.key.timestamp},event.key.keysym.scancode,event.key.keysym.sym,event.key.repeat > 0,{!static_cast<bool>((event.key.keysym.mod & KMOD_SHIFT) || (event.key.keysym.mod & KMOD_ALT) || (event.key.keysym.mod & KMOD_CTRL) || (event.key.keysym.mod & KMOD_GUI) || (event.key.keysym.mod & KMOD_CAPS) || (event.key.keysym.mod & KMOD_NUM) || (event.key.keysym.mod & KMOD_MODE)),static_cast<bool>(event.key.keysym.mod & KMOD_SHIFT),static_cast<bool>(event.key.keysym.mod & KMOD_LSHIFT),static_cast<bool>(event.key.keysym.mod & KMOD_RSHIFT),static_cast<bool>(event.key.keysym.mod & KMOD_CTRL),static_cast<bool>(event.key.keysym.mod & KMOD_LCTRL),static_cast<bool>(event.key.keysym.mod & KMOD_RCTRL),static_cast<bool>(event.key.keysym.mod & KMOD_ALT),static_cast<bool>(event.key.keysym.mod & KMOD_LALT),static_cast<bool>(event.key.keysym.mod & KMOD_RALT),static_cast<bool>(event.key.keysym.mod & KMOD_GUI),static_cast<bool>(event.key.keysym.mod & KMOD_LGUI),static_cast<bool>(event.key.keysym.mod & KMOD_RGUI),static_cast<bool>(event.key.keysym.mod & KMOD_CAPS),static_cast<bool>(event.key.keysym.mod & KMOD_NUM),static_cast<bool>(event.key.keysym.mod & KMOD_MODE)}});
 				break;
 			}
 			case SDL_WINDOWEVENT: {
 				switch(event.window.event) {
 					case SDL_WINDOWEVENT_SHOWN: {
+						minimized = false;
 						onWindowShow({{event.window.timestamp}, _wx, _wy, _ww, _wh});
 						break;
 					}
@@ -592,19 +2612,31 @@ private:
 					case SDL_WINDOWEVENT_SIZE_CHANGED: {
 						_ww = event.window.data1;
 						_wh = event.window.data2;
-						recreateTextures();
-						onWindowResize({{event.window.timestamp}, _wx, _wy, _ww, _wh});
+						if(resizeDebounce == 0 || replaying) {applyResize();}
+						else {
+							// Wait for the size to settle, dragging a window edge sends a stream of these
+							resizeAt = SDL_GetTicks() + resizeDebounce;
+							resizePending = true;
+							if(onDemand) {requestRedrawIn(resizeDebounce);}
+						}
+						break;
+					}
+					case SDL_WINDOWEVENT_HIDDEN: {
+						minimized = true;
 						break;
 					}
 					case SDL_WINDOWEVENT_MINIMIZED: {
+						minimized = true;
 						onWindowMinimize({{event.window.timestamp}, _wx, _wy, _ww, _wh});
 						break;
 					}
 					case SDL_WINDOWEVENT_MAXIMIZED: {
+						minimized = false;
 						onWindowMaximize({{event.window.timestamp}, _wx, _wy, _ww, _wh});
 						break;
 					}
 					case SDL_WINDOWEVENT_RESTORED: {
+						minimized = false;
 						onWindowRestore({{event.window.timestamp}, _wx, _wy, _ww, _wh});
 						break;
 					}
@@ -642,8 +2674,429 @@ private:
 						break;
 					}
 				}
+				break;
+			}
+			case SDL_RENDER_TARGETS_RESET: {
+				// Target textures lost their contents
+				for(auto& layer : layers) {layer->dirty = true;}
+				break;
+			}
+			case SDL_RENDER_DEVICE_RESET: {
+				// The textures themselves are gone
+				resizeLayers(true);
+				break;
+			}
+		}
+	}
+	void flushMotion() {
+		motionPending = false;
+		const int16_t rx = std::max(std::min(motionRx, (int32_t)INT16_MAX), (int32_t)INT16_MIN);
+		const int16_t ry = std::max(std::min(motionRy, (int32_t)INT16_MAX), (int32_t)INT16_MIN);
+		onMouseMove({{motionTimestamp}, _mx, _my, rx, ry, down});
+	}
+	template<typename T> void recordValue(T value) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		recordBuffer.insert(recordBuffer.end(), bytes, bytes + sizeof(T));
+	}
+	template<typename T> bool replayRead(T& value) {
+		if(replayPos + sizeof(T) > replayData.size()) {return false;}
+		memcpy(&value, replayData.data() + replayPos, sizeof(T));
+		replayPos += sizeof(T);
+		return true;
+	}
+	void recordEvent(const SDL_Event& event) {
+		// Only the fields handleEvent reads are stored
+		switch(event.type) {
+			case SDL_QUIT: {
+				recordValue(REC_QUIT);
+				recordValue(event.quit.timestamp);
+				break;
+			}
+			case SDL_MOUSEBUTTONDOWN: case SDL_MOUSEBUTTONUP: {
+				recordValue(event.type == SDL_MOUSEBUTTONDOWN ? REC_MOUSE_DOWN : REC_MOUSE_UP);
+				recordValue(event.button.timestamp);
+				recordValue(event.button.button);
+				recordValue(event.button.clicks);
+				break;
+			}
+			case SDL_MOUSEMOTION: {
+				recordValue(REC_MOTION);
+				recordValue(event.motion.timestamp);
+				recordValue((int32_t)event.motion.x);
+				recordValue((int32_t)event.motion.y);
+				recordValue((int32_t)event.motion.xrel);
+				recordValue((int32_t)event.motion.yrel);
+				break;
+			}
+			case SDL_MOUSEWHEEL: {
+				recordValue(REC_WHEEL);
+				recordValue(event.wheel.timestamp);
+				recordValue((int32_t)event.wheel.x);
+				recordValue((int32_t)event.wheel.y);
+				recordValue((uint8_t)(event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED));
+				break;
+			}
+			case SDL_KEYDOWN: case SDL_KEYUP: {
+				recordValue(event.type == SDL_KEYDOWN ? REC_KEY_DOWN : REC_KEY_UP);
+				recordValue(event.key.timestamp);
+				recordValue((int32_t)event.key.keysym.scancode);
+				recordValue((int32_t)event.key.keysym.sym);
+				recordValue((uint16_t)event.key.keysym.mod);
+				recordValue(event.key.repeat);
+				break;
+			}
+			case SDL_WINDOWEVENT: {
+				recordValue(REC_WINDOW);
+				recordValue(event.window.timestamp);
+				recordValue(event.window.event);
+				recordValue((int32_t)event.window.data1);
+				recordValue((int32_t)event.window.data2);
+				break;
+			}
+		}
+	}
+	void recordFrame(double dt) {
+		recordValue(REC_FRAME);
+		recordValue(dt);
+		if(recordBuffer.size() >= 1 << 16) {
+			fwrite(recordBuffer.data(), 1, recordBuffer.size(), recordFile);
+			recordBuffer.clear();
+		}
+	}
+	bool replayEvents() {
+		// Sends the recorded events of the next frame through handleEvent, false once the recording has ended
+		uint8_t tag;
+		while(replayRead(tag)) {
+			if(tag == REC_FRAME) {
+				if(!replayRead(replayDt)) {return false;}
+				if(replayRealtime) {
+					// Wait until the frame is as far from the start as it was when recorded
+					replayClock += replayDt;
+					const uint64_t freq = SDL_GetPerformanceFrequency(), due = replayStart + (uint64_t)(replayClock * freq), now = SDL_GetPerformanceCounter();
+					if(now < due) {SDL_Delay((due - now) * 1000 / freq);}
+				}
+				return true;
+			}
+			SDL_Event event;
+			memset(&event, 0, sizeof(event));
+			bool complete = replayRead(event.common.timestamp);
+			int32_t a = 0, b = 0, c = 0, d = 0;
+			uint8_t flag = 0;
+			uint16_t mod = 0;
+			switch(tag) {
+				case REC_QUIT: event.type = SDL_QUIT; break;
+				case REC_MOUSE_DOWN: case REC_MOUSE_UP: {
+					event.type = tag == REC_MOUSE_DOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+					complete = complete && replayRead(event.button.button) && replayRead(event.button.clicks);
+					break;
+				}
+				case REC_MOTION: {
+					event.type = SDL_MOUSEMOTION;
+					complete = complete && replayRead(a) && replayRead(b) && replayRead(c) && replayRead(d);
+					event.motion.x = a;
+					event.motion.y = b;
+					event.motion.xrel = c;
+					event.motion.yrel = d;
+					break;
+				}
+				case REC_WHEEL: {
+					event.type = SDL_MOUSEWHEEL;
+					complete = complete && replayRead(a) && replayRead(b) && replayRead(flag);
+					event.wheel.x = a;
+					event.wheel.y = b;
+					event.wheel.direction = flag ? SDL_MOUSEWHEEL_FLIPPED : SDL_MOUSEWHEEL_NORMAL;
+					break;
+				}
+				case REC_KEY_DOWN: case REC_KEY_UP: {
+					event.type = tag == REC_KEY_DOWN ? SDL_KEYDOWN : SDL_KEYUP;
+					complete = complete && replayRead(a) && replayRead(b) && replayRead(mod) && replayRead(event.key.repeat);
+					event.key.keysym.scancode = (SDL_Scancode)a;
+					event.key.keysym.sym = b;
+					event.key.keysym.mod = mod;
+					break;
+				}
+				case REC_WINDOW: {
+					event.type = SDL_WINDOWEVENT;
+					complete = complete && replayRead(event.window.event) && replayRead(a) && replayRead(b);
+					event.window.data1 = a;
+					event.window.data2 = b;
+					// Resize the real window too, the resulting live event is ignored like all live input
+					if(complete && window != NULL && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {SDL_SetWindowSize(window, a, b);}
+					break;
+				}
+				default: return false;
+			}
+			if(!complete) {return false;}
+			handleEvent(event);
+			if(!running) {return true;}
+		}
+		return false;
+	}
+	void captureFrame() {
+		// With every buffer still queued the frame is dropped before paying for the readback, or the main thread waits for the encoder
+		std::unique_lock<std::mutex> lock(capture.mutex);
+		if(capture.free.empty() && capture.policy == CAPTURE_DROP) {
+			++capture.stats.dropped;
+			++capture.skipped;
+			return;
+		}
+		capture.cv.wait(lock, [this] {return !capture.free.empty();});
+		CaptureFrame* frame = capture.free.back();
+		capture.free.pop_back();
+		lock.unlock();
+
+		// The size is fixed when the capture starts, a smaller window leaves the rest black
+		int32_t w = 0, h = 0;
+		SDL_GetRendererOutputSize(renderer, &w, &h);
+		if(w < capture.w || h < capture.h) {memset(frame->pixels.data(), 0, frame->pixels.size());}
+		SDL_Rect area = {0, 0, capture.w, capture.h};
+		SDL_RenderReadPixels(renderer, &area, SDL_PIXELFORMAT_RGBA32, frame->pixels.data(), capture.w * 4);
+		frame->repeat = 1 + capture.skipped;
+		capture.skipped = 0;
+		++capture.stats.frames;
+
+		lock.lock();
+		capture.queue.push_back(frame);
+		capture.cv.notify_all();
+	}
+	void captureWorker() {
+		std::unique_lock<std::mutex> lock(capture.mutex);
+		while(true) {
+			capture.cv.wait(lock, [this] {return !capture.queue.empty() || capture.quit;});
+			if(capture.queue.empty()) {return;}
+			CaptureFrame* frame = capture.queue.front();
+			capture.queue.pop_front();
+			lock.unlock();
+			switch(capture.format) {
+				case CAPTURE_GIF: captureGIF(*frame); break;
+				case CAPTURE_Y4M: captureY4M(*frame); break;
+				case CAPTURE_RAW: {
+					for(uint32_t i = 0; i < frame->repeat; ++i) {fwrite(frame->pixels.data(), 1, frame->pixels.size(), capture.file);}
+					break;
+				}
+			}
+			lock.lock();
+			capture.free.push_back(frame);
+			capture.cv.notify_all();
+		}
+	}
+	void captureY4M(const CaptureFrame& frame) {
+		// Full range BT.601 (what C420jpeg means), chroma from the average of every 2x2 block
+		const int32_t w = capture.w, h = capture.h, cw = (w + 1) / 2, ch = (h + 1) / 2;
+		const uint8_t* pixels = frame.pixels.data();
+		std::vector<uint8_t>& out = capture.out;
+		out.resize((size_t)w * h + (size_t)cw * ch * 2);
+		uint8_t* luma = out.data();
+		uint8_t* u = luma + (size_t)w * h;
+		uint8_t* v = u + (size_t)cw * ch;
+		for(size_t i = 0; i < (size_t)w * h; ++i) {
+			const uint8_t* p = &pixels[i * 4];
+			luma[i] = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+		}
+		for(int32_t cy = 0; cy < ch; ++cy) {
+			for(int32_t cx = 0; cx < cw; ++cx) {
+				int32_t r = 0, g = 0, b = 0, n = 0;
+				for(int32_t y = cy * 2; y < cy * 2 + 2 && y < h; ++y) {
+					for(int32_t x = cx * 2; x < cx * 2 + 2 && x < w; ++x, ++n) {
+						const uint8_t* p = &pixels[((size_t)y * w + x) * 4];
+						r += p[0];
+						g += p[1];
+						b += p[2];
+					}
+				}
+				r = (r + n / 2) / n;
+				g = (g + n / 2) / n;
+				b = (b + n / 2) / n;
+				u[(size_t)cy * cw + cx] = std::min((-43 * r - 85 * g + 128 * b + 32896) >> 8, 255);
+				v[(size_t)cy * cw + cx] = std::min((128 * r - 107 * g - 21 * b + 32896) >> 8, 255);
 			}
 		}
+		for(uint32_t i = 0; i < frame.repeat; ++i) {
+			fputs("FRAME\n", capture.file);
+			fwrite(out.data(), 1, out.size(), capture.file);
+		}
+	}
+	void captureGIF(const CaptureFrame& frame) {
+		// Delays are whole centiseconds and viewers slow down anything under 2, a frame that would be shown shorter absorbs the next one
+		const uint32_t start = (capture.time * 100 + capture.fps / 2) / capture.fps;
+		capture.time += frame.repeat;
+		const uint32_t delay = (capture.time * 100 + capture.fps / 2) / capture.fps - start;
+		if(!capture.pending.empty() && capture.pendingDelay < 2) {
+			capture.pendingDelay += delay;
+			return;
+		}
+		captureFlushGIF();
+		capture.pendingDelay = delay;
+
+		// Only the rectangle that changed since the last written frame is stored, the rest of that frame stays on screen
+		const int32_t w = capture.w, h = capture.h;
+		const uint8_t* pixels = frame.pixels.data();
+		int32_t x0 = 0, y0 = 0, x1 = w, y1 = h;
+		if(!capture.previous.empty()) {
+			const uint32_t* now = (const uint32_t*)pixels;
+			const uint32_t* old = (const uint32_t*)capture.previous.data();
+			x0 = w;
+			y0 = h;
+			x1 = y1 = 0;
+			for(int32_t y = 0; y < h; ++y, now += w, old += w) {
+				if(memcmp(now, old, (size_t)w * 4) == 0) {continue;}
+				int32_t left = 0, right = w;
+				while(now[left] == old[left]) {++left;}
+				while(now[right - 1] == old[right - 1]) {--right;}
+				x0 = std::min(x0, left);
+				x1 = std::max(x1, right);
+				y0 = std::min(y0, y);
+				y1 = y + 1;
+			}
+			if(x0 >= x1) {x0 = y0 = 0; x1 = y1 = 1;} // Nothing changed, an unchanged pixel keeps the frame and its delay
+		}
+		capture.previous.assign(frame.pixels.begin(), frame.pixels.end());
+
+		// Median cut palette: colors are reduced to 15 bits, the box with the most pixels times its widest channel range is split at its median pixel
+		std::vector<uint32_t>& histogram = capture.histogram;
+		std::vector<uint16_t>& colors = capture.colors;
+		histogram.assign(1 << 15, 0);
+		colors.clear();
+		auto colorKey = [](const uint8_t* p) {return (p[0] >> 3) << 10 | (p[1] >> 3) << 5 | p[2] >> 3;};
+		for(int32_t y = y0; y < y1; ++y) {
+			for(int32_t x = x0; x < x1; ++x) {++histogram[colorKey(&pixels[((size_t)y * w + x) * 4])];}
+		}
+		for(uint32_t key = 0; key < 1 << 15; ++key) {
+			if(histogram[key] > 0) {colors.push_back(key);}
+		}
+		struct Box {
+			uint32_t begin, end;
+			uint64_t count;
+			uint8_t channel, range;
+		} boxes[256];
+		auto setBox = [&](Box& box, uint32_t begin, uint32_t end) {
+			uint8_t lo[3] = {31, 31, 31}, hi[3] = {0, 0, 0};
+			box = {begin, end, 0, 0, 0};
+			for(uint32_t i = begin; i < end; ++i) {
+				for(uint8_t c = 0; c < 3; ++c) {
+					uint8_t value = (colors[i] >> (10 - 5 * c)) & 31;
+					lo[c] = std::min(lo[c], value);
+					hi[c] = std::max(hi[c], value);
+				}
+				box.count += histogram[colors[i]];
+			}
+			for(uint8_t c = 0; c < 3; ++c) {
+				if(hi[c] - lo[c] > box.range) {
+					box.range = hi[c] - lo[c];
+					box.channel = c;
+				}
+			}
+		};
+		uint16_t numBoxes = 1;
+		setBox(boxes[0], 0, colors.size());
+		while(numBoxes < 256) {
+			Box* box = NULL;
+			for(uint16_t i = 0; i < numBoxes; ++i) {
+				if(boxes[i].range > 0 && (box == NULL || boxes[i].count * boxes[i].range > box->count * box->range)) {box = &boxes[i];}
+			}
+			if(box == NULL) {break;}
+			const uint8_t shift = 10 - 5 * box->channel;
+			std::sort(colors.begin() + box->begin, colors.begin() + box->end, [shift](uint16_t a, uint16_t b) {return ((a >> shift) & 31) < ((b >> shift) & 31);});
+			uint32_t mid = box->begin + 1;
+			uint64_t below = histogram[colors[box->begin]];
+			while(mid < box->end - 1 && below * 2 < box->count) {below += histogram[colors[mid++]];}
+			const uint32_t end = box->end;
+			setBox(*box, box->begin, mid);
+			setBox(boxes[numBoxes++], mid, end);
+		}
+		uint8_t bits = 1;
+		while((1 << bits) < numBoxes) {++bits;}
+
+		// Graphic control extension (the delay is filled in by captureFlushGIF), image descriptor and palette
+		std::vector<uint8_t>& out = capture.pending;
+		const int32_t rw = x1 - x0, rh = y1 - y0;
+		out = {0x21, 0xF9, 4, 0x04, 0, 0, 0, 0, 0x2C, (uint8_t)x0, (uint8_t)(x0 >> 8), (uint8_t)y0, (uint8_t)(y0 >> 8),
+		       (uint8_t)rw, (uint8_t)(rw >> 8), (uint8_t)rh, (uint8_t)(rh >> 8), (uint8_t)(0x80 | (bits - 1))};
+		out.resize(out.size() + (3 << bits), 0);
+		uint8_t* palette = &out[out.size() - (3 << bits)];
+		for(uint16_t b = 0; b < numBoxes; ++b) {
+			uint64_t sum[3] = {0, 0, 0};
+			for(uint32_t i = boxes[b].begin; i < boxes[b].end; ++i) {
+				for(uint8_t c = 0; c < 3; ++c) {
+					uint32_t value = (colors[i] >> (10 - 5 * c)) & 31;
+					sum[c] += (uint64_t)(value << 3 | value >> 2) * histogram[colors[i]];
+				}
+			}
+			for(uint8_t c = 0; c < 3; ++c) {palette[b * 3 + c] = (sum[c] + boxes[b].count / 2) / boxes[b].count;}
+			for(uint32_t i = boxes[b].begin; i < boxes[b].end; ++i) {histogram[colors[i]] = b;} // The histogram becomes the color to index table
+		}
+		std::vector<uint8_t>& indices = capture.indices;
+		indices.resize((size_t)rw * rh);
+		for(int32_t y = y0, i = 0; y < y1; ++y) {
+			for(int32_t x = x0; x < x1; ++x, ++i) {indices[i] = histogram[colorKey(&pixels[((size_t)y * w + x) * 4])];}
+		}
+		const uint8_t minCode = std::max<uint8_t>(bits, 2);
+		out.push_back(minCode);
+		captureLZW(indices.data(), indices.size(), minCode, out);
+	}
+	void captureLZW(const uint8_t* data, size_t n, uint8_t minCode, std::vector<uint8_t>& out) {
+		// GIF flavoured LZW, the dictionary is a hash table of (prefix code, index) pairs and starts over when it reaches 4096 codes
+		static constexpr uint32_t HASH_SIZE = 1 << 13;
+		const uint32_t clearCode = 1 << minCode, endCode = clearCode + 1;
+		std::vector<int32_t>& keys = capture.lzwKeys;
+		std::vector<uint16_t>& codes = capture.lzwCodes;
+		std::vector<uint8_t>& bytes = capture.out;
+		keys.assign(HASH_SIZE, -1);
+		codes.resize(HASH_SIZE);
+		bytes.clear();
+		uint32_t next = clearCode + 2, codeSize = minCode + 1, bits = 0;
+		uint64_t acc = 0;
+		auto emit = [&](uint32_t code) {
+			acc |= (uint64_t)code << bits;
+			for(bits += codeSize; bits >= 8; bits -= 8, acc >>= 8) {bytes.push_back((uint8_t)acc);}
+		};
+		emit(clearCode);
+		uint32_t prefix = data[0];
+		for(size_t i = 1; i < n; ++i) {
+			const int32_t key = (int32_t)(prefix << 8 | data[i]);
+			uint32_t slot = ((uint32_t)key * 2654435761u) >> 19;
+			while(keys[slot] != -1 && keys[slot] != key) {slot = (slot + 1) & (HASH_SIZE - 1);}
+			if(keys[slot] == key) {
+				prefix = codes[slot];
+				continue;
+			}
+			emit(prefix);
+			keys[slot] = key;
+			codes[slot] = next;
+			if(next == 1u << codeSize) {++codeSize;}
+			if(++next == 4096) {
+				emit(clearCode);
+				keys.assign(HASH_SIZE, -1);
+				next = clearCode + 2;
+				codeSize = minCode + 1;
+			}
+			prefix = data[i];
+		}
+		emit(prefix);
+		if(next == 1u << codeSize && codeSize < 12) {++codeSize;} // The decoder adds one more code after the last one and may widen
+		emit(endCode);
+		if(bits > 0) {bytes.push_back((uint8_t)acc);}
+		for(size_t i = 0; i < bytes.size(); i += 255) {
+			const uint8_t length = std::min<size_t>(bytes.size() - i, 255);
+			out.push_back(length);
+			out.insert(out.end(), bytes.begin() + i, bytes.begin() + i + length);
+		}
+		out.push_back(0);
+	}
+	void captureFlushGIF() {
+		if(capture.pending.empty()) {return;}
+		const uint16_t delay = std::min<uint32_t>(capture.pendingDelay, 65535);
+		capture.pending[4] = delay & 0xFF;
+		capture.pending[5] = delay >> 8;
+		fwrite(capture.pending.data(), 1, capture.pending.size(), capture.file);
+		capture.pending.clear();
+	}
+	void resetInputEdges() {
+		// Presses, releases and movement are counted from one game loop to the next
+		input.pressed.reset();
+		input.released.reset();
+		input.buttonsPressed = input.buttonsReleased = 0;
+		input.rx = input.ry = input.wheelX = input.wheelY = 0;
 	}
 	#ifdef ARGON_DYNAMIC_RESIZE
 		static int handleResize(void* instance, SDL_Event* event) {
@@ -657,23 +3110,905 @@ private:
 		}
 	#endif
 
+	void applyResize() {
+		resizePending = false;
+		recreateTextures();
+		resizeLayers(false);
+		onWindowResize({{SDL_GetTicks()}, _wx, _wy, _ww, _wh});
+	}
 	void recreateTextures() {
-		for(int16_t i = textures.size()-1; i >= 0; --i) {
-			if(textures[i] != NULL) {
-				SDL_DestroyTexture(textures[i]);
-				textures[i] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, _ww, _wh);
+		for(auto& slot : textureSlots) {
+			if(!slot.live || slot.texture == NULL) {continue;}
+			SDL_Texture* old = slot.texture;
+			auto found = textureInfo.find(old);
+			TextureInfo info = found != textureInfo.end() ? found->second : TextureInfo{TEXTURE_FOLLOW_WINDOW, false, 0, 0, false, slot.index, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING};
+			if(info.resize == TEXTURE_FIXED || (info.w == _ww && info.h == _wh)) {continue;}
+
+			// POW2 textures keep their allocation while the window fits and is not below half of it
+			int32_t cw = 0, ch = 0;
+			SDL_QueryTexture(old, NULL, NULL, &cw, &ch);
+			SDL_Texture* texture = old;
+			if(info.resize != TEXTURE_POW2 || _ww > cw || _wh > ch || (_ww <= cw / 2 && _wh <= ch / 2)) {
+				texture = NULL;
+				if(info.resize == TEXTURE_POW2) {texture = allocTexture(nextPow2(_ww), nextPow2(_wh), info.format, info.access);}
+				if(texture == NULL) {texture = allocTexture(_ww, _wh, info.format, info.access);}
+				if(texture == NULL) {continue;}
+			}
+
+			// Move the CPU side buffers over, keeping the overlap when preserved
+			auto shadow = shadowBuffers.find(old);
+			auto indexed = indexedTextures.find(old);
+			std::vector<uint8_t> pixels;
+			if(shadow != shadowBuffers.end()) {
+				if(info.preserve) {
+					pixels = std::move(shadow->second);
+					resizePixels(pixels, info.w, info.h, _ww, _wh, 4);
+				}
+				shadowBuffers.erase(shadow);
+			}
+			if(indexed != indexedTextures.end()) {
+				// Keep the palette, without preserve the indices are reallocated at the new size by the next lockIndexed
+				IndexedTexture moved = std::move(indexed->second);
+				if(info.preserve) {resizePixels(moved.indices, info.w, info.h, _ww, _wh, 1);}
+				else {moved.indices.clear();}
+				indexedTextures.erase(indexed);
+				indexed = indexedTextures.emplace(texture, std::move(moved)).first;
+			}
+			textureInfo.erase(old);
+			info.w = _ww;
+			info.h = _wh;
+			info.locked = false;
+			textureInfo[texture] = info;
+			if(texture != old) {
+				releaseTexture(old);
+				slot.texture = texture;
+			}
+
+			// Upload the preserved contents, the rest of the texture is cleared
+			if(!pixels.empty()) {
+				SDL_Rect rect = {0, 0, _ww, _wh};
+				SDL_UpdateTexture(texture, &rect, pixels.data(), _ww * 4);
+				shadowBuffers[texture] = std::move(pixels);
+			}
+			else if(indexed != indexedTextures.end() && !indexed->second.indices.empty()) {
+				uploadIndexed(texture, indexed->second, _ww, {0, 0, _ww, _wh});
+			}
+		}
+	}
+
+	// Layers have the output's size, recreating one leaves it dirty until it is drawn again
+	void resizeLayers(bool force) {
+		int32_t w = 0, h = 0;
+		if(!outputSize(w, h)) {return;}
+		for(auto& layer : layers) {
+			if(force || layer->texture == NULL || layer->w != w || layer->h != h) {allocLayer(*layer);}
+		}
+	}
+	bool allocLayer(Layer& layer) {
+		int32_t w = _ww, h = _wh;
+		if(!outputSize(w, h)) {
+			w = _ww;
+			h = _wh;
+		}
+		if(layer.texture != NULL) {SDL_DestroyTexture(layer.texture);}
+		layer.texture = SDL_CreateTexture(renderer, getNativeFormat(), SDL_TEXTUREACCESS_TARGET, w, h);
+		layer.w = w;
+		layer.h = h;
+		layer.dirty = true;
+		if(layer.texture == NULL) {return false;}
+
+		// Drawing onto transparent black premultiplies the colors by their alpha, so layers are composited premultiplied
+		#if SDL_VERSION_ATLEAST(2, 0, 6)
+			SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+			                                                         SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+			if(SDL_SetTextureBlendMode(layer.texture, premultiplied) == 0) {return true;}
+		#endif
+		SDL_SetTextureBlendMode(layer.texture, SDL_BLENDMODE_BLEND);
+		return true;
+	}
+	Layer* insertLayer(std::unique_ptr<Layer> layer) {
+		auto at = std::upper_bound(layers.begin(), layers.end(), layer->order, [](int16_t order, const std::unique_ptr<Layer>& other) {return order < other->order;});
+		return layers.insert(at, std::move(layer))->get();
+	}
+	std::vector<std::unique_ptr<Layer>>::iterator findLayer(Layer* layer) {
+		return std::find_if(layers.begin(), layers.end(), [layer](const std::unique_ptr<Layer>& other) {return other.get() == layer;});
+	}
+	bool outputSize(int32_t& w, int32_t& h) {
+		if(renderTarget != NULL) {
+			w = targetOutputW;
+			h = targetOutputH;
+			return true;
+		}
+		return SDL_GetRendererOutputSize(renderer, &w, &h) == 0 && w > 0 && h > 0;
+	}
+	bool beginTarget(SDL_Texture* texture, float scaleX, float scaleY, bool clear) {
+		// Everything queued so far belongs to the previous target
+		if(renderTarget != NULL) {endTarget();}
+		flushCommands();
+		int32_t w = _ww, h = _wh;
+		outputSize(w, h);
+		if(SDL_SetRenderTarget(renderer, texture) != 0) {return false;}
+		renderTarget = texture;
+		targetOutputW = w;
+		targetOutputH = h;
+		drawColorValid = drawBlendValid = false;
+		SDL_RenderSetScale(renderer, scaleX, scaleY);
+		frameStats.sdlCalls += 2;
+		if(clear) {
+			setColor(0x00000000);
+			SDL_RenderClear(renderer);
+			++frameStats.sdlCalls;
+		}
+		return true;
+	}
+	void endTarget() {
+		if(renderTarget == NULL) {return;}
+		flushCommands();
+		SDL_SetRenderTarget(renderer, NULL);
+		++frameStats.sdlCalls;
+		drawColorValid = drawBlendValid = false;
+		renderTarget = NULL;
+	}
+	void compositeLayers(int32_t maxOrder) {
+		// Queued like drawTexture, so layers cover everything drawn before them and the profiler overlay covers them
+		for(auto& layer : layers) {
+			if(layer->order <= layersDrawnTo || layer->order > maxOrder) {continue;}
+			if(layer->visible && layer->texture != NULL) {queueCommand(CMD_TEXTURE, 0, layer->texture, {0, 0, _ww, _wh});}
+		}
+		layersDrawnTo = std::max(layersDrawnTo, maxOrder);
+	}
+
+	// SIMD Pixel Kernels, every function works on one row of 32 bit pixels
+	struct PixelKernelTable {
+		SimdLevel level;
+		void (*fill)(uint32_t* dst, uint32_t value, int32_t count);
+		void (*blend)(uint32_t* dst, const uint32_t* src, int32_t count);
+		void (*blendColor)(uint32_t* dst, uint32_t value, int32_t count);
+		void (*rotate)(uint32_t* pixels, int32_t count, bool left);
+		void (*expand)(uint32_t* dst, const uint8_t* src, const uint32_t* palette, int32_t count);
+	};
+	static const PixelKernelTable& pixelKernels() {return *activePixelKernels().load(std::memory_order_acquire);}
+	static const PixelKernelTable* pixelKernelTables() {
+		static const PixelKernelTable tables[3] = {selectPixelKernels(SIMD_SCALAR), selectPixelKernels(SIMD_SSE2), selectPixelKernels(SIMD_AVX2)};
+		return tables;
+	}
+	static std::atomic<const PixelKernelTable*>& activePixelKernels() {
+		// Switching levels swaps the pointer to a table that never changes, so jobs and the pixel thread never see a half written table
+		static std::atomic<const PixelKernelTable*> table{&pixelKernelTables()[SIMD_AVX2]};
+		return table;
+	}
+	static PixelKernelTable selectPixelKernels(SimdLevel level) {
+		#ifdef ARGON_SIMD_X86
+			if(level >= SIMD_AVX2 && SDL_HasAVX2()) {return {SIMD_AVX2, fillRowAVX2, blendRowAVX2, blendColorRowAVX2, rotateRowAVX2, expandRowAVX2};}
+			if(level >= SIMD_SSE2 && SDL_HasSSE2()) {return {SIMD_SSE2, fillRowSSE2, blendRowSSE2, blendColorRowSSE2, rotateRowSSE2, expandRowScalar};}
+		#endif
+		return {SIMD_SCALAR, fillRowScalar, blendRowScalar, blendColorRowScalar, rotateRowScalar, expandRowScalar};
+	}
+	static inline uint32_t pixelValue(uint32_t color, uint32_t format = SDL_PIXELFORMAT_RGBA32) {
+		// 0xRRGGBBAA to the 32 bit value with the bytes R, G, B, A (or B, G, R, A) in memory
+		Framebuffer fb = {NULL, 0, 0, 0, {0, 0, 0, 0}, format};
+		return fb.value(color);
+	}
+	static bool clipPixelRect(int32_t fw, int32_t fh, int32_t& x, int32_t& y, int32_t& w, int32_t& h) {
+		if(x < 0) {w += x; x = 0;}
+		if(y < 0) {h += y; y = 0;}
+		w = std::min(w, fw - x);
+		h = std::min(h, fh - y);
+		return w > 0 && h > 0;
+	}
+	static bool clipPixelBlit(const Framebuffer& dst, int32_t& x, int32_t& y, int32_t& sx, int32_t& sy, int32_t& w, int32_t& h) {
+		if(dst.pixels == NULL) {return false;}
+		if(x < 0) {sx = -x; w += x; x = 0;}
+		if(y < 0) {sy = -y; h += y; y = 0;}
+		w = std::min(w, dst.w - x);
+		h = std::min(h, dst.h - y);
+		return w > 0 && h > 0;
+	}
+
+	// Blending works on bytes so the result is the same on every path: out = (src * a + dst * (255 - a)) / 255, alpha uses 255 instead of a
+	static inline uint8_t blendChannel(uint32_t s, uint32_t d, uint32_t sa, uint32_t ia) {
+		uint32_t v = s * sa + d * ia + 128;
+		return (v + (v >> 8)) >> 8;
+	}
+	static void fillRowScalar(uint32_t* dst, uint32_t value, int32_t count) {
+		for(int32_t i = 0; i < count; ++i) {dst[i] = value;}
+	}
+	static void blendRowScalar(uint32_t* dst, const uint32_t* src, int32_t count) {
+		uint8_t* d = reinterpret_cast<uint8_t*>(dst);
+		const uint8_t* s = reinterpret_cast<const uint8_t*>(src);
+		for(int32_t i = 0; i < count * 4; i += 4) {
+			const uint32_t a = s[i+3], ia = 255 - a;
+			d[i] = blendChannel(s[i], d[i], a, ia);
+			d[i+1] = blendChannel(s[i+1], d[i+1], a, ia);
+			d[i+2] = blendChannel(s[i+2], d[i+2], a, ia);
+			d[i+3] = blendChannel(s[i+3], d[i+3], 255, ia);
+		}
+	}
+	static void blendColorRowScalar(uint32_t* dst, uint32_t value, int32_t count) {
+		// Same as blendRowScalar with every source pixel set to value
+		const uint8_t* s = reinterpret_cast<const uint8_t*>(&value);
+		uint8_t* d = reinterpret_cast<uint8_t*>(dst);
+		const uint32_t a = s[3], ia = 255 - a;
+		for(int32_t i = 0; i < count * 4; i += 4) {
+			d[i] = blendChannel(s[0], d[i], a, ia);
+			d[i+1] = blendChannel(s[1], d[i+1], a, ia);
+			d[i+2] = blendChannel(s[2], d[i+2], a, ia);
+			d[i+3] = blendChannel(s[3], d[i+3], 255, ia);
+		}
+	}
+	static void rotateRowScalar(uint32_t* pixels, int32_t count, bool left) {
+		// Moving the last byte in memory to the front is a left rotate on little endian machines
+		for(int32_t i = 0; i < count; ++i) {
+			uint8_t* p = reinterpret_cast<uint8_t*>(pixels + i);
+			uint8_t t;
+			if(left) {t = p[3]; p[3] = p[2]; p[2] = p[1]; p[1] = p[0]; p[0] = t;}
+			else {t = p[0]; p[0] = p[1]; p[1] = p[2]; p[2] = p[3]; p[3] = t;}
+		}
+	}
+	static void expandRowScalar(uint32_t* dst, const uint8_t* src, const uint32_t* palette, int32_t count) {
+		// SSE2 has no gather, a plain lookup is as fast
+		for(int32_t i = 0; i < count; ++i) {dst[i] = palette[src[i]];}
+	}
+	#ifdef ARGON_SIMD_X86
+		__attribute__((target("sse2"))) static inline __m128i blendSSE2(__m128i s, __m128i d, __m128i alphaMask, __m128i c128, __m128i c255) {
+			// Two pixels in 16 bit lanes
+			__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i sa = _mm_or_si128(a, alphaMask);
+			__m128i ia = _mm_sub_epi16(c255, a);
+			__m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, sa), _mm_mullo_epi16(d, ia)), c128);
+			return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+		}
+		__attribute__((target("sse2"))) static void fillRowSSE2(uint32_t* dst, uint32_t value, int32_t count) {
+			const __m128i v = _mm_set1_epi32(value);
+			int32_t i = 0;
+			for(; i + 4 <= count; i += 4) {_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);}
+			fillRowScalar(dst + i, value, count - i);
+		}
+		__attribute__((target("sse2"))) static void blendRowSSE2(uint32_t* dst, const uint32_t* src, int32_t count) {
+			const __m128i zero = _mm_setzero_si128(), c128 = _mm_set1_epi16(128), c255 = _mm_set1_epi16(255);
+			const __m128i alphaMask = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+			int32_t i = 0;
+			for(; i + 4 <= count; i += 4) {
+				__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+				__m128i lo = blendSSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), alphaMask, c128, c255);
+				__m128i hi = blendSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), alphaMask, c128, c255);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+			}
+			blendRowScalar(dst + i, src + i, count - i);
+		}
+		__attribute__((target("sse2"))) static void blendColorRowSSE2(uint32_t* dst, uint32_t value, int32_t count) {
+			// The source half of the blend is the same for every pixel and only computed once
+			const __m128i zero = _mm_setzero_si128(), c128 = _mm_set1_epi16(128);
+			const uint16_t a = reinterpret_cast<const uint8_t*>(&value)[3];
+			const __m128i s = _mm_unpacklo_epi8(_mm_set1_epi32(value), zero);
+			const __m128i sTerm = _mm_add_epi16(_mm_mullo_epi16(s, _mm_set_epi16(255, a, a, a, 255, a, a, a)), c128);
+			const __m128i ia = _mm_set1_epi16(255 - a);
+			int32_t i = 0;
+			for(; i + 4 <= count; i += 4) {
+				__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+				__m128i lo = _mm_add_epi16(sTerm, _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia));
+				__m128i hi = _mm_add_epi16(sTerm, _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia));
+				lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+				hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+			}
+			blendColorRowScalar(dst + i, value, count - i);
+		}
+		__attribute__((target("sse2"))) static void rotateRowSSE2(uint32_t* pixels, int32_t count, bool left) {
+			int32_t i = 0;
+			for(; i + 4 <= count; i += 4) {
+				__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+				p = left ? _mm_or_si128(_mm_slli_epi32(p, 8), _mm_srli_epi32(p, 24)) : _mm_or_si128(_mm_srli_epi32(p, 8), _mm_slli_epi32(p, 24));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), p);
+			}
+			rotateRowScalar(pixels + i, count - i, left);
+		}
+		__attribute__((target("avx2"))) static void fillRowAVX2(uint32_t* dst, uint32_t value, int32_t count) {
+			const __m256i v = _mm256_set1_epi32(value);
+			int32_t i = 0;
+			for(; i + 8 <= count; i += 8) {_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);}
+			fillRowScalar(dst + i, value, count - i);
+		}
+		__attribute__((target("avx2"))) static void blendRowAVX2(uint32_t* dst, const uint32_t* src, int32_t count) {
+			const __m256i zero = _mm256_setzero_si256(), c128 = _mm256_set1_epi16(128), c255 = _mm256_set1_epi16(255);
+			const __m256i alphaMask = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+			int32_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+				__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+				__m256i out[2];
+				for(uint8_t half = 0; half < 2; ++half) {
+					__m256i s16 = half ? _mm256_unpackhi_epi8(s, zero) : _mm256_unpacklo_epi8(s, zero);
+					__m256i d16 = half ? _mm256_unpackhi_epi8(d, zero) : _mm256_unpacklo_epi8(d, zero);
+					__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+					__m256i v = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s16, _mm256_or_si256(a, alphaMask)), _mm256_mullo_epi16(d16, _mm256_sub_epi16(c255, a))), c128);
+					out[half] = _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+				}
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(out[0], out[1]));
+			}
+			blendRowSSE2(dst + i, src + i, count - i);
+		}
+		__attribute__((target("avx2"))) static void blendColorRowAVX2(uint32_t* dst, uint32_t value, int32_t count) {
+			const __m256i zero = _mm256_setzero_si256(), c128 = _mm256_set1_epi16(128);
+			const int16_t a = reinterpret_cast<const uint8_t*>(&value)[3];
+			const __m256i s = _mm256_unpacklo_epi8(_mm256_set1_epi32(value), zero);
+			const __m256i sTerm = _mm256_add_epi16(_mm256_mullo_epi16(s, _mm256_set_epi16(255, a, a, a, 255, a, a, a, 255, a, a, a, 255, a, a, a)), c128);
+			const __m256i ia = _mm256_set1_epi16(255 - a);
+			int32_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+				__m256i lo = _mm256_add_epi16(sTerm, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), ia));
+				__m256i hi = _mm256_add_epi16(sTerm, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), ia));
+				lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+				hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+			}
+			blendColorRowSSE2(dst + i, value, count - i);
+		}
+		__attribute__((target("avx2"))) static void rotateRowAVX2(uint32_t* pixels, int32_t count, bool left) {
+			int32_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+				p = left ? _mm256_or_si256(_mm256_slli_epi32(p, 8), _mm256_srli_epi32(p, 24)) : _mm256_or_si256(_mm256_srli_epi32(p, 8), _mm256_slli_epi32(p, 24));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), p);
+			}
+			rotateRowSSE2(pixels + i, count - i, left);
+		}
+		__attribute__((target("avx2"))) static void expandRowAVX2(uint32_t* dst, const uint8_t* src, const uint32_t* palette, int32_t count) {
+			int32_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), index, 4));
+			}
+			expandRowScalar(dst + i, src + i, palette, count - i);
+		}
+	#endif
+
+	// Batching
+	enum BatchType : uint8_t {BATCH_NONE, BATCH_POINTS, BATCH_RECTS, BATCH_FILL_RECTS, BATCH_LINES};
+	BatchType batchType = BATCH_NONE;
+	std::vector<uint32_t> batchColors;
+	std::vector<SDL_Point> batchPoints;
+	std::vector<SDL_Rect> batchRects;
+	std::vector<uint32_t> batchOrder;
+	std::vector<SDL_Point> batchGroupPoints;
+	std::vector<SDL_Rect> batchGroupRects;
+	#if SDL_VERSION_ATLEAST(2, 0, 18)
+		std::vector<SDL_Vertex> batchVertices;
+		std::vector<int> batchIndices;
+	#endif
+
+	void beginBatch(BatchType type) {
+		if(batchType != BATCH_NONE) {flushBatch();}
+		batchType = type;
+		batchColors.clear();
+		batchPoints.clear();
+		batchRects.clear();
+	}
+	void flushBatch() {
+		BatchType type = batchType;
+		batchType = BATCH_NONE;
+		if(batchColors.empty()) {return;}
+		if(deferred) {
+			// Record as regular commands so they are sorted and merged with the rest of the frame
+			for(size_t i = 0; i < batchColors.size(); ++i) {
+				switch(type) {
+					case BATCH_POINTS: queueCommand(CMD_POINT, batchColors[i], NULL, {batchPoints[i].x, batchPoints[i].y, 1, 1}); break;
+					case BATCH_RECTS: queueCommand(CMD_RECT, batchColors[i], NULL, batchRects[i]); break;
+					case BATCH_FILL_RECTS: queueCommand(CMD_FILL_RECT, batchColors[i], NULL, batchRects[i]); break;
+					default: break;
+				}
+			}
+			if(type == BATCH_LINES && batchPoints.size() > 1) {
+				// The whole strip is one command, its points are kept until the commands are flushed
+				const int32_t first = stripPoints.size();
+				stripPoints.insert(stripPoints.end(), batchPoints.begin(), batchPoints.end());
+				queueCommand(CMD_LINES, batchColors[0], NULL, {first, (int32_t)batchPoints.size(), 0, 0});
+			}
+			return;
+		}
+		flushQuads();
+		if(type == BATCH_LINES) {
+			if(batchPoints.size() > 1) {
+				setColor(batchColors[0]);
+				SDL_RenderDrawLines(renderer, batchPoints.data(), batchPoints.size());
+				++frameStats.sdlCalls;
+			}
+			return;
+		}
+
+		// Single color fast path, submit arrays as is
+		size_t count = batchColors.size();
+		bool uniform = true;
+		for(size_t i = 1; i < count && uniform; ++i) {uniform = batchColors[i] == batchColors[0];}
+		if(uniform) {
+			setColor(batchColors[0]);
+			submitBatch(type, batchPoints.data(), batchRects.data(), count);
+			return;
+		}
+
+		// Group primitives by color so each color is a single SDL call
+		batchOrder.resize(count);
+		for(uint32_t i = 0; i < count; ++i) {batchOrder[i] = i;}
+		std::stable_sort(batchOrder.begin(), batchOrder.end(), [this](uint32_t a, uint32_t b) {return batchColors[a] < batchColors[b];});
+		size_t groups = 1;
+		for(size_t i = 1; i < count; ++i) {groups += batchColors[batchOrder[i]] != batchColors[batchOrder[i-1]];}
+
+		#if SDL_VERSION_ATLEAST(2, 0, 18)
+			// Too many colors to group efficiently, draw everything as colored quads in one call
+			if(type != BATCH_RECTS && groups > ARGON_BATCH_GEOMETRY_COLORS) {
+				submitBatchGeometry(type, count);
+				return;
+			}
+		#endif
+		for(size_t start = 0, end = 0; start < count; start = end) {
+			uint32_t color = batchColors[batchOrder[start]];
+			batchGroupPoints.clear();
+			batchGroupRects.clear();
+			for(end = start; end < count && batchColors[batchOrder[end]] == color; ++end) {
+				if(type == BATCH_POINTS) {batchGroupPoints.push_back(batchPoints[batchOrder[end]]);}
+				else {batchGroupRects.push_back(batchRects[batchOrder[end]]);}
+			}
+			setColor(color);
+			submitBatch(type, batchGroupPoints.data(), batchGroupRects.data(), end - start);
+		}
+	}
+	void submitBatch(BatchType type, const SDL_Point* points, const SDL_Rect* rects, size_t count) {
+		++frameStats.sdlCalls;
+		switch(type) {
+			case BATCH_POINTS: SDL_RenderDrawPoints(renderer, points, count); break;
+			case BATCH_RECTS: SDL_RenderDrawRects(renderer, rects, count); break;
+			case BATCH_FILL_RECTS: SDL_RenderFillRects(renderer, rects, count); break;
+			default: break;
+		}
+	}
+	#if SDL_VERSION_ATLEAST(2, 0, 18)
+		void submitBatchGeometry(BatchType type, size_t count) {
+			batchVertices.resize(count * 4);
+			batchIndices.resize(count * 6);
+			bool blend = false;
+			for(size_t i = 0; i < count; ++i) {
+				uint32_t c = batchColors[i];
+				SDL_Color color = {(uint8_t)(c>>24), (uint8_t)(c>>16), (uint8_t)(c>>8), (uint8_t)c};
+				blend |= color.a != 255;
+				float x, y, w, h;
+				if(type == BATCH_POINTS) {x = batchPoints[i].x; y = batchPoints[i].y; w = h = 1;}
+				else {x = batchRects[i].x; y = batchRects[i].y; w = batchRects[i].w; h = batchRects[i].h;}
+				SDL_Vertex* v = &batchVertices[i*4];
+				v[0] = {{x, y}, color, {0, 0}};
+				v[1] = {{x + w, y}, color, {0, 0}};
+				v[2] = {{x + w, y + h}, color, {0, 0}};
+				v[3] = {{x, y + h}, color, {0, 0}};
+				int* idx = &batchIndices[i*6];
+				int base = i*4;
+				idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+				idx[3] = base; idx[4] = base + 2; idx[5] = base + 3;
+			}
+			setBlendMode(blend ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+			++frameStats.sdlCalls;
+			SDL_RenderGeometry(renderer, NULL, batchVertices.data(), batchVertices.size(), batchIndices.data(), batchIndices.size());
+		}
+	#endif
+
+	static inline uint32_t packColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+		return ((uint32_t)r << 24) | ((uint32_t)g << 16) | ((uint32_t)b << 8) | a;
+	}
+	// Deferred Rendering
+	enum CommandType : uint8_t {CMD_CLEAR, CMD_POINT, CMD_LINE, CMD_LINES, CMD_RECT, CMD_FILL_RECT, CMD_TEXTURE};
+	struct DrawCommand {
+		CommandType type;
+		uint32_t color;
+		SDL_Texture* texture;
+		SDL_Rect rect; // x1, y1, x2, y2 for lines, first point & count in stripPoints for line strips
+		uint32_t segment;
+	};
+	struct SegmentBounds {
+		SDL_Texture* texture;
+		uint32_t color;
+		SDL_Rect bounds;
+	};
+	static constexpr uint8_t MAX_SEGMENT_KEYS = 64;
+
+	bool deferred = false;
+	std::vector<DrawCommand> commands;
+	std::vector<DrawCommand> sortedCommands;
+	std::vector<uint32_t> commandOrder;
+	std::vector<SegmentBounds> segmentBounds;
+	std::vector<SDL_Point> commandPoints;
+	std::vector<SDL_Point> stripPoints;
+	std::vector<SDL_Rect> commandRects;
+	uint32_t segment = 0;
+	DrawStats frameStats = {0, 0, 0};
+	DrawStats lastDrawStats = {0, 0, 0};
+
+	// Texture Atlases, images are packed left to right into shelves as tall as the tallest image so far with 1px of padding
+	struct AtlasPage {
+		SDL_Texture* texture;
+		int32_t w;
+		int32_t h;
+	};
+	struct Atlas {
+		int32_t pageSize;
+		std::vector<AtlasPage> pages;
+		int32_t shelfPage; // Page the shelves are on, images too large for a page get a page of their own
+		int32_t shelfX;
+		int32_t shelfY;
+		int32_t shelfH;
+	};
+
+	bool atlasPack(Atlas& atlas, SDL_Surface* surface, const SDL_Rect& src, uint16_t* page, SDL_Rect* rect) {
+		// Copies src of a SDL_PIXELFORMAT_RGBA32 surface into the atlas, rect is where it ended up on page
+		const int32_t w = src.w, h = src.h, size = atlas.pageSize;
+		if(w <= 0 || h <= 0 || atlas.pages.size() >= UINT16_MAX) {return false;}
+		int32_t target = -1;
+		if(w + 1 <= size && h + 1 <= size) {
+			if(atlas.shelfPage >= 0 && atlas.shelfX + w + 1 > size) {
+				atlas.shelfX = 0;
+				atlas.shelfY += atlas.shelfH;
+				atlas.shelfH = 0;
+			}
+			if(atlas.shelfPage < 0 || atlas.shelfY + h + 1 > size) {
+				if(!atlasAddPage(atlas, size, size)) {return false;}
+				atlas.shelfPage = atlas.pages.size() - 1;
+				atlas.shelfX = atlas.shelfY = atlas.shelfH = 0;
+			}
+			target = atlas.shelfPage;
+			*rect = {atlas.shelfX, atlas.shelfY, w, h};
+			atlas.shelfX += w + 1;
+			atlas.shelfH = std::max(atlas.shelfH, h + 1);
+		}
+		else {
+			if(!atlasAddPage(atlas, w, h)) {return false;}
+			target = atlas.pages.size() - 1;
+			*rect = {0, 0, w, h};
+		}
+		*page = target;
+		const uint8_t* pixels = (const uint8_t*)surface->pixels + (size_t)src.y * surface->pitch + src.x * 4;
+		SDL_UpdateTexture(atlas.pages[target].texture, rect, pixels, surface->pitch);
+		return true;
+	}
+	bool atlasAddPage(Atlas& atlas, int32_t w, int32_t h) {
+		SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, w, h);
+		if(texture == NULL) {return false;}
+		std::vector<uint8_t> clear((size_t)w * h * 4, 0);
+		SDL_UpdateTexture(texture, NULL, clear.data(), w * 4);
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		atlas.pages.push_back({texture, w, h});
+		return true;
+	}
+	void atlasFree(Atlas& atlas) {
+		flushQuads();
+		for(AtlasPage& page : atlas.pages) {SDL_DestroyTexture(page.texture);}
+		atlas.pages.clear();
+		atlas.shelfPage = -1;
+		atlas.shelfX = atlas.shelfY = atlas.shelfH = 0;
+	}
+
+	// Textured Quads (glyphs & sprites), queued until the texture changes or anything else is drawn so draw order is kept
+	#if SDL_VERSION_ATLEAST(2, 0, 18)
+		SDL_Texture* quadTexture = NULL;
+		std::vector<SDL_Vertex> quadVertices;
+		std::vector<int> quadIndices; // 0, 1, 2, 0, 2, 3 for every quad, shared by all quad draws
+
+		static void makeQuad(SDL_Vertex* v, const AtlasPage& page, const SDL_Rect& src, const SDL_FPoint* corners, SDL_Color color) {
+			const float u0 = (float)src.x / page.w, v0 = (float)src.y / page.h;
+			const float u1 = (float)(src.x + src.w) / page.w, v1 = (float)(src.y + src.h) / page.h;
+			v[0] = {corners[0], color, {u0, v0}};
+			v[1] = {corners[1], color, {u1, v0}};
+			v[2] = {corners[2], color, {u1, v1}};
+			v[3] = {corners[3], color, {u0, v1}};
+		}
+		void drawQuads(SDL_Texture* texture, const SDL_Vertex* vertices, size_t count) {
+			const size_t quads = count / 4;
+			for(size_t i = quadIndices.size() / 6; i < quads; ++i) {
+				const int base = i * 4, idx[6] = {base, base + 1, base + 2, base, base + 2, base + 3};
+				quadIndices.insert(quadIndices.end(), idx, idx + 6);
+			}
+			++frameStats.sdlCalls;
+			SDL_RenderGeometry(renderer, texture, vertices, count, quadIndices.data(), quads * 6);
+		}
+	#endif
+
+	void queueQuad(const AtlasPage& page, const SDL_Rect& src, const SDL_FPoint* corners, SDL_Color color) {
+		// Corners are top left, top right, bottom right, bottom left
+		#if SDL_VERSION_ATLEAST(2, 0, 18)
+			if(page.texture != quadTexture) {
+				flushQuads();
+				quadTexture = page.texture;
+			}
+			quadVertices.resize(quadVertices.size() + 4);
+			makeQuad(&quadVertices[quadVertices.size() - 4], page, src, corners, color);
+		#else
+			// No SDL_RenderGeometry, copy the (rotated) rectangle directly
+			float dx = corners[1].x - corners[0].x, dy = corners[1].y - corners[0].y;
+			float w = std::sqrt(dx * dx + dy * dy), h = std::hypot(corners[3].x - corners[0].x, corners[3].y - corners[0].y);
+			float cx = (corners[0].x + corners[2].x) / 2, cy = (corners[0].y + corners[2].y) / 2;
+			SDL_Rect dst = {(int)std::lround(cx - w / 2), (int)std::lround(cy - h / 2), (int)std::lround(w), (int)std::lround(h)};
+			SDL_SetTextureColorMod(page.texture, color.r, color.g, color.b);
+			SDL_SetTextureAlphaMod(page.texture, color.a);
+			SDL_RenderCopyEx(renderer, page.texture, &src, &dst, std::atan2(dy, dx) * 180 / M_PI, NULL, SDL_FLIP_NONE);
+			++frameStats.sdlCalls;
+		#endif
+	}
+	void flushQuads() {
+		#if SDL_VERSION_ATLEAST(2, 0, 18)
+			if(quadVertices.empty()) {return;}
+			drawQuads(quadTexture, quadVertices.data(), quadVertices.size());
+			quadVertices.clear();
+		#endif
+	}
+
+	// Sprites, the handle is the index into sprites + 1
+	struct SpriteInfo {
+		uint16_t page;
+		SDL_Rect rect;
+	};
+	Atlas spriteAtlas = {ARGON_SPRITE_PAGE_SIZE, {}, -1, 0, 0, 0};
+	std::vector<SpriteInfo> sprites;
+	bool spriteBatch = false;
+	#if SDL_VERSION_ATLEAST(2, 0, 18)
+		std::vector<std::vector<SDL_Vertex>> spriteBuckets; // Quads of the current batch for every atlas texture
+	#endif
+
+	static SDL_Surface* spriteSurface(SDL_Surface* surface) {
+		// Atlases are SDL_PIXELFORMAT_RGBA32, a color key set on the surface becomes transparent
+		if(surface == NULL || surface->format->format == SDL_PIXELFORMAT_RGBA32) {return surface;}
+		return SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+	}
+	Sprite packSprite(SDL_Surface* surface, SDL_Rect rect) {
+		SDL_Rect bounds = {0, 0, surface->w, surface->h};
+		if(!SDL_IntersectRect(&rect, &bounds, &rect)) {return 0;}
+		SpriteInfo info;
+		if(!atlasPack(spriteAtlas, surface, rect, &info.page, &info.rect)) {return 0;}
+		sprites.push_back(info);
+		return sprites.size();
+	}
+
+	// Instanced Circles, white circles baked once per mode side by side from ARGON_CIRCLE_SPRITE_SIZE down to 4 pixels wide
+	Atlas circleSheets[2] = {{0, {}, -1, 0, 0, 0}, {0, {}, -1, 0, 0, 0}}; // Hard edged, anti-aliased
+	std::vector<SDL_Rect> circleCells; // Largest first, same layout in both sheets
+
+	Atlas& circleSheet(bool smooth) {
+		Atlas& sheet = circleSheets[smooth];
+		if(!sheet.pages.empty()) {return sheet;}
+		if(circleCells.empty()) {
+			for(int32_t size = ARGON_CIRCLE_SPRITE_SIZE, x = 0; size >= 4; x += size + 2, size /= 2) {circleCells.push_back({x, 0, size + 2, size + 2});}
+		}
+		const int32_t w = circleCells.back().x + circleCells.back().w, h = circleCells[0].h;
+		if(!atlasAddPage(sheet, w, h)) {return sheet;}
+		// Transparent pixels are white too so linear filtering doesn't darken the edges
+		std::vector<uint32_t> pixels((size_t)w * h, pixelValue(0xFFFFFF00));
+		for(const SDL_Rect& cell : circleCells) {
+			const float r = (cell.w - 2) / 2.0f, center = cell.w / 2.0f;
+			for(int32_t y = 0; y < cell.h; ++y) {
+				for(int32_t x = 0; x < cell.w; ++x) {
+					const float d = std::hypot(x + 0.5f - center, y + 0.5f - center);
+					const float coverage = smooth ? std::min(std::max(r - d + 0.5f, 0.0f), 1.0f) : (d < r ? 1.0f : 0.0f);
+					pixels[(size_t)y * w + cell.x + x] = pixelValue(0xFFFFFF00 | (uint32_t)(coverage * 255 + 0.5f));
+				}
+			}
+		}
+		SDL_UpdateTexture(sheet.pages[0].texture, NULL, pixels.data(), w * 4);
+		#if SDL_VERSION_ATLEAST(2, 0, 12)
+			SDL_SetTextureScaleMode(sheet.pages[0].texture, smooth ? SDL_ScaleModeLinear : SDL_ScaleModeNearest);
+		#endif
+		return sheet;
+	}
+
+	// Glyph Atlas, one per font with the Latin-1 glyphs (like TTF_RenderText) rendered in white on demand
+	#ifdef ARGON_INCLUDE_TTF
+		struct Glyph {
+			bool cached;
+			uint16_t page;
+			int16_t advance;
+			SDL_Rect rect; // Position & size in the page, w is 0 if there is nothing to draw
+		};
+		struct GlyphAtlas {
+			int32_t height;
+			Glyph glyphs[256];
+			std::vector<int16_t> kerning[256]; // Kerning after each glyph, a row is filled in on first use
+			Atlas atlas;
+		};
+		bool glyphAtlasEnabled = true;
+		std::unordered_map<Font*, GlyphAtlas> glyphAtlases;
+
+		GlyphAtlas& glyphAtlas(Font* font) {
+			// Fonts can change size (TTF_SetFontSize), start over when the height doesn't match anymore
+			int32_t height = TTF_FontHeight(font);
+			auto found = glyphAtlases.find(font);
+			if(found != glyphAtlases.end() && found->second.height == height) {return found->second;}
+			freeGlyphAtlas(font);
+			GlyphAtlas& glyphs = glyphAtlases[font];
+			glyphs.height = height;
+			glyphs.atlas = {ARGON_GLYPH_PAGE_SIZE, {}, -1, 0, 0, 0};
+			while(glyphs.atlas.pageSize < height * 4) {glyphs.atlas.pageSize <<= 1;}
+			for(Glyph& glyph : glyphs.glyphs) {glyph = {false, 0, 0, {0, 0, 0, 0}};}
+			return glyphs;
+		}
+		void freeGlyphAtlas(Font* font) {
+			auto found = glyphAtlases.find(font);
+			if(found == glyphAtlases.end()) {return;}
+			atlasFree(found->second.atlas);
+			glyphAtlases.erase(found);
+		}
+		const Glyph& cacheGlyph(GlyphAtlas& glyphs, Font* font, uint8_t ch) {
+			Glyph& glyph = glyphs.glyphs[ch];
+			if(glyph.cached) {return glyph;}
+			glyph.cached = true;
+			int minx, maxx, miny, maxy, advance = 0;
+			if(TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &advance) == 0) {glyph.advance = advance;}
+
+			// The rendered glyph is a single character string, so it lines up with the pen position like in TTF_RenderText
+			SDL_Surface* rendered = TTF_RenderGlyph_Blended(font, ch, {255, 255, 255, 255});
+			if(rendered == NULL) {return glyph;}
+			SDL_Surface* surface = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_FreeSurface(rendered);
+			if(surface == NULL) {return glyph;}
+			if(!atlasPack(glyphs.atlas, surface, {0, 0, surface->w, surface->h}, &glyph.page, &glyph.rect)) {glyph.rect = {0, 0, 0, 0};}
+			SDL_FreeSurface(surface);
+			return glyph;
+		}
+		int16_t glyphKerning(GlyphAtlas& glyphs, Font* font, uint8_t prev, uint8_t ch) {
+			std::vector<int16_t>& row = glyphs.kerning[prev];
+			if(row.empty()) {row.assign(256, INT16_MIN);}
+			if(row[ch] == INT16_MIN) {row[ch] = TTF_GetFontKerningSizeGlyphs(font, prev, ch);}
+			return row[ch];
+		}
+	#endif
+
+	// Cached renderer state
+	bool drawColorValid = false;
+	bool drawBlendValid = false;
+	uint32_t drawColor = 0;
+	SDL_BlendMode drawBlend = SDL_BLENDMODE_NONE;
+
+	void queueCommand(CommandType type, uint32_t color, SDL_Texture* texture, SDL_Rect rect) {
+		DrawCommand cmd = {type, color, texture, rect, 0};
+		if(!deferred) {
+			executeCommands(&cmd, 1);
+			return;
+		}
+
+		// Commands with different state may only be reordered if they don't overlap, otherwise start a new segment
+		SDL_Rect bounds = rect;
+		if(type == CMD_LINE) {
+			bounds = {std::min(rect.x, rect.w), std::min(rect.y, rect.h), std::abs(rect.w - rect.x) + 1, std::abs(rect.h - rect.y) + 1};
+		}
+		else if(type == CMD_LINES) {
+			SDL_EnclosePoints(&stripPoints[rect.x], rect.y, NULL, &bounds);
+		}
+		SegmentBounds* same = NULL;
+		for(SegmentBounds& b : segmentBounds) {
+			if(b.texture == texture && b.color == color) {same = &b;}
+			else if(SDL_HasIntersection(&b.bounds, &bounds)) {
+				same = NULL;
+				segmentBounds.clear();
+				++segment;
+				break;
+			}
+		}
+		if(same != NULL) {SDL_UnionRect(&same->bounds, &bounds, &same->bounds);}
+		else {
+			if(segmentBounds.size() >= MAX_SEGMENT_KEYS) {
+				segmentBounds.clear();
+				++segment;
 			}
-			else {textures.erase(textures.begin() + i);}
+			segmentBounds.push_back({texture, color, bounds});
 		}
+		cmd.segment = segment;
+		commands.push_back(cmd);
+		++frameStats.commands;
+	}
+	void flushCommands() {
+		flushQuads();
+		if(commands.empty()) {return;}
+		commandOrder.resize(commands.size());
+		for(uint32_t i = 0; i < commands.size(); ++i) {commandOrder[i] = i;}
+		std::stable_sort(commandOrder.begin(), commandOrder.end(), [this](uint32_t ai, uint32_t bi) {
+			const DrawCommand& a = commands[ai];
+			const DrawCommand& b = commands[bi];
+			if(a.segment != b.segment) {return a.segment < b.segment;}
+			if(commandBlend(a) != commandBlend(b)) {return commandBlend(a) < commandBlend(b);}
+			if(a.texture != b.texture) {return a.texture < b.texture;}
+			return a.color < b.color;
+		});
+		sortedCommands.clear();
+		for(uint32_t i : commandOrder) {sortedCommands.push_back(commands[i]);}
+		executeCommands(sortedCommands.data(), sortedCommands.size());
+		commands.clear();
+		stripPoints.clear();
+		segmentBounds.clear();
+		segment = 0;
+	}
+	void executeCommands(const DrawCommand* cmds, size_t count) {
+		flushQuads();
+		for(size_t i = 0, end = 0; i < count; i = end) {
+			// Merge runs of identical state & type into a single SDL call
+			const DrawCommand& cmd = cmds[i];
+			for(end = i + 1; end < count && cmds[end].type == cmd.type && cmds[end].color == cmd.color && cmds[end].texture == cmd.texture; ++end) {}
+			if(cmd.type != CMD_TEXTURE) {setColor(cmd.color);}
+			switch(cmd.type) {
+				case CMD_CLEAR: {
+					SDL_RenderClear(renderer);
+					++frameStats.sdlCalls;
+					break;
+				}
+				case CMD_POINT: {
+					commandPoints.clear();
+					for(size_t j = i; j < end; ++j) {commandPoints.push_back({cmds[j].rect.x, cmds[j].rect.y});}
+					SDL_RenderDrawPoints(renderer, commandPoints.data(), commandPoints.size());
+					++frameStats.sdlCalls;
+					break;
+				}
+				case CMD_RECT:
+				case CMD_FILL_RECT: {
+					commandRects.clear();
+					for(size_t j = i; j < end; ++j) {commandRects.push_back(cmds[j].rect);}
+					if(cmd.type == CMD_RECT) {SDL_RenderDrawRects(renderer, commandRects.data(), commandRects.size());}
+					else {SDL_RenderFillRects(renderer, commandRects.data(), commandRects.size());}
+					++frameStats.sdlCalls;
+					break;
+				}
+				case CMD_LINE: {
+					for(size_t j = i; j < end; ++j) {
+						SDL_RenderDrawLine(renderer, cmds[j].rect.x, cmds[j].rect.y, cmds[j].rect.w, cmds[j].rect.h);
+						++frameStats.sdlCalls;
+					}
+					break;
+				}
+				case CMD_LINES: {
+					// Strips can't be joined, each one is a single call
+					for(size_t j = i; j < end; ++j) {
+						SDL_RenderDrawLines(renderer, &stripPoints[cmds[j].rect.x], cmds[j].rect.y);
+						++frameStats.sdlCalls;
+					}
+					break;
+				}
+				case CMD_TEXTURE: {
+					for(size_t j = i; j < end; ++j) {
+						SDL_Rect src = {0, 0, 0, 0};
+						textureSize(cmds[j].texture, &src.w, &src.h);
+						SDL_RenderCopy(renderer, cmds[j].texture, &src, NULL);
+						++frameStats.sdlCalls;
+					}
+					break;
+				}
+			}
+		}
+	}
+	static inline uint8_t commandBlend(const DrawCommand& cmd) {
+		return (cmd.texture == NULL && (uint8_t)cmd.color != 255) ? 1 : 0;
+	}
+
+	// Used by calls that draw through SDL directly (SDL_GFX, SDL_TTF), keeps draw order and invalidates cached state
+	SDL_Renderer* directRenderer() {
+		flushCommands();
+		drawColorValid = drawBlendValid = false;
+		return renderer;
 	}
 
 	inline void setColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-		SDL_SetRenderDrawColor(renderer, r, g, b, a);
-		SDL_SetRenderDrawBlendMode(renderer, (a == 255) ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+		setColor(packColor(r, g, b, a));
 	}
 	inline void setColor(uint32_t c) {
-		SDL_SetRenderDrawColor(renderer, (uint8_t)(c>>24), (uint8_t)(c>>16), (uint8_t)(c>>8), (uint8_t)c);
-		SDL_SetRenderDrawBlendMode(renderer, ((uint8_t)c) ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+		if(!drawColorValid || c != drawColor) {
+			SDL_SetRenderDrawColor(renderer, (uint8_t)(c>>24), (uint8_t)(c>>16), (uint8_t)(c>>8), (uint8_t)c);
+			drawColor = c;
+			drawColorValid = true;
+			++frameStats.sdlCalls;
+		}
+		else {++frameStats.stateChangesAvoided;}
+		setBlendMode(((uint8_t)c == 255) ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+	}
+	inline void setBlendMode(SDL_BlendMode blend) {
+		if(!drawBlendValid || blend != drawBlend) {
+			SDL_SetRenderDrawBlendMode(renderer, blend);
+			drawBlend = blend;
+			drawBlendValid = true;
+			++frameStats.sdlCalls;
+		}
+		else {++frameStats.stateChangesAvoided;}
 	}
 };
 